@@ -25,218 +25,229 @@ SOFTWARE
 
 #include <iostream>
 
-#include <set>
-#include <numeric> // std::accumulate
-
-#include <omp.h>
-#include <parallel/algorithm>
+#include "cnn.h"
+#include "vs_cnn.h"
+#include "tools/io.h"
 
 #include "clustering.h"
 
 namespace Clustering {
 
-    // INTERFACE CLUSTERING
-    vector<vector<unsigned int> >
-    clustering(Clustering::Core::Similarity similarity,
-               vector<vector<float> > &data,
-               const float cut,
-               const unsigned int sim,
-               const int Nkeep,
-               const bool mutual) {
-        // Obtain neighbor lists
-        Neighbors neighbor_lists;
-        Neighbors second_neighbor_lists;
-        nns::neighbors(neighbor_lists, data, cut, 0);
-
-        // Obtain clusters
-        return Clustering::Core::algorithm(similarity,
-                                           data,
-                                           neighbor_lists,
-                                           second_neighbor_lists,
-                                           cut,
-                                           sim,
-                                           Nkeep,
-                                           mutual);
-    }
-
-    // INTERFACE HIERARCHICAL CLUSTERING
-    vector<clstep>
-    hierarchical_clustering(Clustering::Core::Similarity similarity,
-                            vector<vector<unsigned int> > &clusters,
-                            vector<vector<float> > &data,
-                            const clstep init_step,
-                            const float delta_fe,
-                            const unsigned int ndims,
-                            const unsigned int Nkeep,
-                            const unsigned int Nsplit,
-                            const bool mutual) {
-        vector<clstep> leaves(clusters.size(), init_step);
-        const float bfactor(std::exp(-delta_fe / ndims));
-
-//#ifdef ENABLE_DEBUG_MACRO
-        auto total_frames = static_cast<float>(data.size());
-        cout << " HIERARCHICAL FREE ENERGY PLAN " << endl;
-        cout << "\tSTEP\tFE\tCUT\tSIM " << endl;
-//#endif
-        clstep prev_step = init_step;
-        clstep step = init_step;
-        bool enough_neighbor_lists = true;
-        while (enough_neighbor_lists) {
-            // Initialize break criteria.
-            vector<size_t> nghbrlst_szs(clusters.size(), 0);
-            // Initialize data for hierarchical level.
-            vector<vector<vector<unsigned int> > > hierarchic_clusters(clusters.size());
-            for (unsigned int cluster_idx = 0; cluster_idx < clusters.size(); cluster_idx++) {
-                if (clusters[cluster_idx].size() > Nsplit) {
-                    Neighbors neighbors_ij;
-                    Neighbors second_neighbors_ij;
-                    nns::neighbors_from_cluster(neighbors_ij,
-                                                clusters[cluster_idx],
-                                                data,
-                                                step.cut,
-                                                0);
-                    nghbrlst_szs[cluster_idx] = neighbors_ij.size();
-
-                    vector<vector<unsigned int> > new_clusters;
-                    new_clusters = Clustering::Core::algorithm(similarity,
-                                                               data,
-                                                               neighbors_ij,
-                                                               second_neighbors_ij,
-                                                               step.cut,
-                                                               step.sim,
-                                                               Nkeep,
-                                                               mutual);
-
-                    // if number of clusters does not increase take the initial cluster
-                    if (new_clusters.empty())
-                        new_clusters.resize(1, clusters[cluster_idx]);
-                    else if (new_clusters.size() == 1)
-                        new_clusters[0] = clusters[cluster_idx];
-
-                    for (const auto &new_cluster : new_clusters)
-                        hierarchic_clusters[cluster_idx].push_back(new_cluster);
-                } else {
-                    hierarchic_clusters[cluster_idx].push_back(clusters[cluster_idx]);
-                }
+    void grow_hierarchy(Hierarchy &tree,
+                        vector<char> &active,
+                        const vector<size_t> &leaves,
+                        const vector<vector<vector<unsigned int> > > &hierarchic_clusters,
+                        const vector<size_t> &nghbrlst_szs,
+                        const clstep &step,
+                        const unsigned int Nkeep,
+                        ofstream &treestream,
+                        const float total_frames) {
+        const size_t first_node(tree.nodes.size());
+        for (size_t leaf_idx = 0; leaf_idx < leaves.size(); leaf_idx++) {
+            const char branch(nghbrlst_szs[leaf_idx] > 2 * Nkeep);
+            if (hierarchic_clusters[leaf_idx].empty()) {
+                active[leaves[leaf_idx]] = branch;
+            } else {
+                tree.split(leaves[leaf_idx], hierarchic_clusters[leaf_idx], step);
+                active[leaves[leaf_idx]] = 0;
+                active.resize(tree.nodes.size(), branch);
             }
-
-            // sorting after parallel loop
-            vector<vector<unsigned int> > output;
-            for (unsigned int cluster_idx = 0; cluster_idx < hierarchic_clusters.size(); cluster_idx++)
-                for (auto new_clusters : hierarchic_clusters[cluster_idx])
-                    output.push_back(new_clusters);
-
-            for (int cluster_idx = (hierarchic_clusters.size() - 1); cluster_idx >= 0; cluster_idx--) {
-                size_t number = hierarchic_clusters[cluster_idx].size() - 1;
-                if (number > 0) {
-                    leaves.at(cluster_idx) = step;
-                    auto leaves_it = leaves.begin() + cluster_idx;
-                    leaves.insert(leaves_it, number, step);
-                }
+        }
+        if (treestream.is_open() && tree.nodes.size() > first_node)
+            write_hierarchy(treestream, tree, first_node);
+
+        // Number of clustered points
+        unsigned int clustered_points(0);
+        size_t num_clusters(0);
+        for (size_t leaf_idx = 0; leaf_idx < leaves.size(); leaf_idx++) {
+            if (hierarchic_clusters[leaf_idx].empty()) {
+                clustered_points += tree.nodes[leaves[leaf_idx]].size();
+                num_clusters++;
+            } else {
+                for (auto const &new_cluster : hierarchic_clusters[leaf_idx])
+                    clustered_points += new_cluster.size();
+                num_clusters += hierarchic_clusters[leaf_idx].size();
             }
-            clusters = output;
-
-            // Number of clustered points
-            unsigned int clustered_points(0);
-            for (auto &cluster : clusters)
-                clustered_points += cluster.size();
+        }
 
 //#ifdef ENABLE_DEBUG_MACRO
-            // Print a little bit of hierarchical tree info
-            std::cout << "STEP " << step.step << " CUT " << step.cut << " SIM " << step.sim << " #clustered "
-                      << clustered_points << " (" << 100.0f * static_cast<float>(clustered_points) / total_frames
-                      << "%) | Clusters: " << clusters.size();
-            for (unsigned int cluster_idx = 0; cluster_idx < hierarchic_clusters.size(); cluster_idx++)
-                for (auto const &new_cluster : hierarchic_clusters[cluster_idx])
-                    cout << " " << cluster_idx << ":" << new_cluster.size();
-            std::cout << std::endl;
-//#endif
-
-            // Setting cutoff for next hierarchical level
-            prev_step = step;
-            step.cut = step.cut * bfactor;
-            step.step++;
-
-            // Stopping criteria
-            enough_neighbor_lists = std::any_of(nghbrlst_szs.begin(),
-                                                nghbrlst_szs.end(),
-                                                [Nkeep](size_t count) { return count > 2 * Nkeep; });
+        // Print a little bit of hierarchical tree info
+        std::cout << "STEP " << step.step << " CUT " << step.cut << " SIM " << step.sim << " #clustered "
+                  << clustered_points << " (" << 100.0f * static_cast<float>(clustered_points) / total_frames
+                  << "%) | Clusters: " << num_clusters;
+        for (size_t leaf_idx = 0; leaf_idx < leaves.size(); leaf_idx++) {
+            if (hierarchic_clusters[leaf_idx].empty())
+                cout << " " << leaf_idx << ":" << tree.nodes[leaves[leaf_idx]].size();
+            else
+                for (auto const &new_cluster : hierarchic_clusters[leaf_idx])
+                    cout << " " << leaf_idx << ":" << new_cluster.size();
         }
-//#ifdef ENABLE_DEBUG_MACRO
-        std::cout << "Total # frames " << total_frames << std::endl;
+        std::cout << std::endl;
 //#endif
-        return leaves;
     }
 
-    // USER INTERFACE MAPPING
-    // Maps the data which was not used in a initial clustering step onto the exiting cluster
-    vector<vector<unsigned int> > cluster_mapping(vector<vector<unsigned int> > &clusters,
-                                                  vector<vector<float> > &full_data,
-                                                  vector<vector<float> > &reduced_data,
-                                                  map<unsigned int, unsigned int> &frames,
-                                                  vector<clstep> &leaves,
-                                                  const unsigned int slice) {
-
-        vector<map<unsigned int, float> > similarity_maps(full_data.size());
-
-        // extract frame ID without slice
-        std::set<unsigned int> true_frames;
-        for (auto const &frame : frames)
-            true_frames.insert(frame.second);
-
-        for (unsigned int cluster_idx = 0; cluster_idx < clusters.size(); cluster_idx++) {
-
-#ifdef _OPENMP
-#pragma omp parallel for default(none) shared(cluster_idx, similarity_maps, clusters, full_data, reduced_data, true_frames, leaves)
-#endif
-            for (size_t frame = 0; frame < full_data.size(); ++frame) {
-                if (true_frames.find(frame) != true_frames.end()) { continue; }
-
-                // Obtain single neighbor list of unclustered frame and
-                // continue the loop if it is empty, i.e., it was smaller than similarity.
-                Neighbors neighbors_from_frame;
-                nns::neighbors_from_frame(neighbors_from_frame,
-                                          frame,
-                                          full_data[frame],
-                                          reduced_data,
-                                          leaves[cluster_idx].cut,
-                                          leaves[cluster_idx].sim);
-
-                if (neighbors_from_frame.count(frame) == 0) { continue; }
-
-                vector<unsigned int> shared_neighbors;
-                Clustering::Core::intersection(shared_neighbors,
-                                               clusters[cluster_idx],
-                                               neighbors_from_frame[frame]);
-
-                if (shared_neighbors.size() >= leaves[cluster_idx].sim) {
-                    float sim_f = static_cast<float>(shared_neighbors.size());
-                    float size_f = static_cast<float>(clusters[cluster_idx].size());
-                    similarity_maps[frame][cluster_idx] = sim_f / size_f;
-                }
-            }
-        }
-
-        map<unsigned int, int> clustered;
-        for (size_t frame = 0; frame < full_data.size(); ++frame) {
-            if (!(similarity_maps[frame].empty())) {
-                auto it = __gnu_parallel::max_element(similarity_maps[frame].begin(),
-                                                      similarity_maps[frame].end());
-                clustered[frame] = it->first;
-            }
-        }
-
-        // Current frames and clusters are scales down by slice;
-        // so scale it up to push the mapped points into the clusters
-        // in the preceding loop.
-        for (size_t i = 0; i < clusters.size(); ++i)
-            for (size_t j = 0; j < clusters[i].size(); ++j)
-                clusters[i][j] = frames[clusters[i][j]];
-
-        for (auto &point : clustered)
-            clusters[point.second].push_back(point.first);
-
-        return clusters;
+    string start_hierarchy(Hierarchy &tree,
+                           vector<char> &active,
+                           clstep &step,
+                           ofstream &treestream,
+                           const string &treefile,
+                           const uint64_t key,
+                           const bool resume) {
+        if (treefile.empty()) return string();
+        const string checkpointfile(treefile + ".ckpt");
+        if (resume && read_checkpoint(checkpointfile, key, tree, active, step))
+            std::cout << "RESUME AT STEP " << step.step << " CUT " << step.cut << std::endl;
+        treestream.open(treefile, std::ios::binary | std::ios::trunc);
+        write_hierarchy(treestream, tree, 0);
+        return checkpointfile;
     }
 
+    // Explicit instantiations for the built-in similarity policies
+    template vector<vector<unsigned int> >
+    clustering<CommonNearestNeighbor::Similarity>(vector<vector<float> > &data,
+                                                  const float cut,
+                                                  const unsigned int sim,
+                                                  const int Nkeep,
+                                                  const bool mutual,
+                                                  const bool deterministic);
+
+    template vector<vector<unsigned int> >
+    clustering<CommonDensity::Similarity>(vector<vector<float> > &data,
+                                          const float cut,
+                                          const unsigned int sim,
+                                          const int Nkeep,
+                                          const bool mutual,
+                                          const bool deterministic);
+
+    template vector<vector<vector<unsigned int> > >
+    sweep<CommonNearestNeighbor::Similarity>(vector<vector<float> > &data,
+                                             const float cut,
+                                             const vector<unsigned int> &sims,
+                                             const int Nkeep);
+
+    template vector<vector<vector<unsigned int> > >
+    sweep<CommonDensity::Similarity>(vector<vector<float> > &data,
+                                     const float cut,
+                                     const vector<unsigned int> &sims,
+                                     const int Nkeep);
+
+    template void
+    hierarchical_clustering<CommonNearestNeighbor::Similarity>(Hierarchy &tree,
+                                                               vector<vector<float> > &data,
+                                                               const float delta_fe,
+                                                               const unsigned int ndims,
+                                                               const unsigned int Nkeep,
+                                                               const unsigned int Nsplit,
+                                                               const bool mutual,
+                                                               const bool deterministic,
+                                                               const string &treefile,
+                                                               const bool resume);
+
+    template void
+    hierarchical_clustering<CommonDensity::Similarity>(Hierarchy &tree,
+                                                       vector<vector<float> > &data,
+                                                       const float delta_fe,
+                                                       const unsigned int ndims,
+                                                       const unsigned int Nkeep,
+                                                       const unsigned int Nsplit,
+                                                       const bool mutual,
+                                                       const bool deterministic,
+                                                       const string &treefile,
+                                                       const bool resume);
+
+    template void
+    fast_hierarchical_clustering<CommonNearestNeighbor::Similarity>(Hierarchy &tree,
+                                                                    vector<vector<float> > &data,
+                                                                    const float delta_fe,
+                                                                    const unsigned int ndims,
+                                                                    const unsigned int Nkeep,
+                                                                    const unsigned int Nsplit,
+                                                                    const bool mutual,
+                                                                    const string &treefile,
+                                                                    const bool resume);
+
+    template void
+    fast_hierarchical_clustering<CommonDensity::Similarity>(Hierarchy &tree,
+                                                            vector<vector<float> > &data,
+                                                            const float delta_fe,
+                                                            const unsigned int ndims,
+                                                            const unsigned int Nkeep,
+                                                            const unsigned int Nsplit,
+                                                            const bool mutual,
+                                                            const string &treefile,
+                                                            const bool resume);
+
+    template vector<clstep>
+    hierarchical_clustering<CommonNearestNeighbor::Similarity>(vector<vector<unsigned int> > &clusters,
+                                                               vector<vector<float> > &data,
+                                                               const clstep init_step,
+                                                               const float delta_fe,
+                                                               const unsigned int ndims,
+                                                               const unsigned int Nkeep,
+                                                               const unsigned int Nsplit,
+                                                               const bool mutual,
+                                                               const bool deterministic);
+
+    template vector<clstep>
+    hierarchical_clustering<CommonDensity::Similarity>(vector<vector<unsigned int> > &clusters,
+                                                       vector<vector<float> > &data,
+                                                       const clstep init_step,
+                                                       const float delta_fe,
+                                                       const unsigned int ndims,
+                                                       const unsigned int Nkeep,
+                                                       const unsigned int Nsplit,
+                                                       const bool mutual,
+                                                       const bool deterministic);
+
+    template vector<vector<unsigned int> >
+    incremental_clustering<CommonNearestNeighbor::Similarity>(vector<unsigned int> &components,
+                                                              vector<vector<float> > &data,
+                                                              const float cut,
+                                                              const unsigned int sim,
+                                                              const int Nkeep);
+
+    template vector<vector<unsigned int> >
+    incremental_clustering<CommonDensity::Similarity>(vector<unsigned int> &components,
+                                                      vector<vector<float> > &data,
+                                                      const float cut,
+                                                      const unsigned int sim,
+                                                      const int Nkeep);
+
+    template class StreamClustering<CommonNearestNeighbor::Similarity>;
+
+    template class StreamClustering<CommonDensity::Similarity>;
+
+    template class Assigner<CommonNearestNeighbor::Similarity>;
+
+    template class Assigner<CommonDensity::Similarity>;
+
+    template vector<vector<unsigned int> >
+    cluster_mapping<CommonNearestNeighbor::Similarity>(vector<vector<unsigned int> > &clusters,
+                                                       vector<vector<float> > &full_data,
+                                                       vector<vector<float> > &reduced_data,
+                                                       map<unsigned int, unsigned int> &frames,
+                                                       vector<clstep> &leaves);
+
+    template vector<vector<unsigned int> >
+    cluster_mapping<CommonDensity::Similarity>(vector<vector<unsigned int> > &clusters,
+                                               vector<vector<float> > &full_data,
+                                               vector<vector<float> > &reduced_data,
+                                               map<unsigned int, unsigned int> &frames,
+                                               vector<clstep> &leaves);
+
+
+    template vector<vector<unsigned int> >
+    hierarchy_mapping<CommonNearestNeighbor::Similarity>(const Hierarchy &tree,
+                                                         vector<vector<float> > &full_data,
+                                                         vector<vector<float> > &reduced_data,
+                                                         map<unsigned int, unsigned int> &frames,
+                                                         vector<clstep> &leaves);
+
+    template vector<vector<unsigned int> >
+    hierarchy_mapping<CommonDensity::Similarity>(const Hierarchy &tree,
+                                                 vector<vector<float> > &full_data,
+                                                 vector<vector<float> > &reduced_data,
+                                                 map<unsigned int, unsigned int> &frames,
+                                                 vector<clstep> &leaves);
+
 }
@@ -27,44 +27,269 @@ SOFTWARE
 #define CNN_CLUSTERING_H
 
 #include <vector>
+#include <string>
+#include <memory>
+#include <unordered_map>
 
-#include "datatypes.h" // clstep, Neighbors
-#include "core.h"      // Clustering::Core::Similarity
+#include "datatypes.h" // clstep, Neighbors, Hierarchy
+#include "core.h"      // Clustering::Core::algorithm
 
 using namespace std;
 
 namespace Clustering {
 
+    // All interfaces are templated on the similarity policy, i.e.,
+    // CommonNearestNeighbor::Similarity, CommonDensity::Similarity or any
+    // policy with the interface described in core.h. The definitions live
+    // in clustering_impl.h.
+    // With `deterministic` the results do not depend on the number of threads.
+    template<class Similarity>
     vector<vector<unsigned int> >
-    clustering(Clustering::Core::Similarity similarity,
-               vector<vector<float> > &data,
+    clustering(vector<vector<float> > &data,
                const float cut,
                const unsigned int sim,
                const int Nkeep,
-               const bool mutual);
+               const bool mutual,
+               const bool deterministic = false);
+
+    // USER INTERFACE SIMILARITY SWEEP
+    // Mutual neighbor clustering for several similarities at once
+    template<class Similarity>
+    vector<vector<vector<unsigned int> > >
+    sweep(vector<vector<float> > &data,
+          const float cut,
+          const vector<unsigned int> &sims,
+          const int Nkeep);
+
+    // USER INTERFACE INCREMENTAL CLUSTERING
+    // Mutual neighbor clustering of data that was appended to already
+    // clustered data. `components` labels every old point by the smallest
+    // point of its component of similar edges and is extended to all points,
+    // starting from none. Only the new points and their neighbors are
+    // evaluated, and the clusters equal those of the deterministic mode.
+    template<class Similarity>
+    vector<vector<unsigned int> >
+    incremental_clustering(vector<unsigned int> &components,
+                           vector<vector<float> > &data,
+                           const float cut,
+                           const unsigned int sim,
+                           const int Nkeep);
 
     // USER INTERFACE HIERARCHICAL CLUSTERING
-    // Hierarchical clustering
+    // Hierarchical clustering. A branch of the hierarchy stops once its
+    // cluster has at most 2 * Nkeep neighbor lists and the levels continue
+    // as long as any branch is active. The clusters are replaced by the
+    // leaves of the hierarchy, which are returned with their steps.
+    template<class Similarity>
     vector<clstep>
-    hierarchical_clustering(Clustering::Core::Similarity similarity,
-                            vector<vector<unsigned int> > &clusters,
+    hierarchical_clustering(vector<vector<unsigned int> > &clusters,
                             vector<vector<float> > &data,
                             const clstep init_step,
                             const float delta_fe,
                             const unsigned int ndims,
                             const unsigned int Nkeep,
                             const unsigned int Nsplit,
-                            const bool mutual);
+                            const bool mutual,
+                            const bool deterministic = false);
+
+    // Hierarchical clustering which grows the tree from its roots, i.e., the
+    // clusters of the initial clustering at the first step. Unless `treefile`
+    // is empty, the tree is written to it level by level (see write_hierarchy)
+    // and every level is checkpointed to `treefile` + ".ckpt". With `resume`,
+    // the levels continue from that checkpoint if it belongs to the same
+    // data, parameters and initial tree.
+    template<class Similarity>
+    void hierarchical_clustering(Hierarchy &tree,
+                                 vector<vector<float> > &data,
+                                 const float delta_fe,
+                                 const unsigned int ndims,
+                                 const unsigned int Nkeep,
+                                 const unsigned int Nsplit,
+                                 const bool mutual,
+                                 const bool deterministic,
+                                 const string &treefile,
+                                 const bool resume = false);
+
+    // USER INTERFACE FAST HIERARCHICAL CLUSTERING
+    // Hierarchical clustering from the neighbor graph of the first level
+    // only. Since the cut only shrinks, the shared neighbors of each edge
+    // are found once and a level only compares them to the threshold of
+    // the edge. The tree equals the one of the deterministic
+    // hierarchical_clustering, which it falls back to if not `mutual`, and
+    // both continue from the checkpoints of each other.
+    template<class Similarity>
+    void fast_hierarchical_clustering(Hierarchy &tree,
+                                      vector<vector<float> > &data,
+                                      const float delta_fe,
+                                      const unsigned int ndims,
+                                      const unsigned int Nkeep,
+                                      const unsigned int Nsplit,
+                                      const bool mutual,
+                                      const string &treefile,
+                                      const bool resume = false);
+
+    // USER INTERFACE ONLINE ASSIGNMENT
+    // Assigns new frames onto the clusters of a reduced data set, e.g., in an
+    // adaptive sampling loop. The indices of the reduced data are built once,
+    // such that a frame only takes a few radius queries. A frame is assigned as
+    // by cluster_mapping onto the index of a cluster, or -1 if it maps on none.
+    template<class Similarity>
+    class Assigner {
+    public:
+        Assigner(const vector<vector<unsigned int> > &clusters,
+                 const vector<vector<float> > &reduced_data,
+                 const vector<clstep> &leaves);
+
+        int assign(const vector<float> &frame) const;
+
+        // Frames are assigned in parallel
+        vector<int> assign(const vector<vector<float> > &frames) const;
+
+        size_t num_clusters() const { return sizes_.size(); }
+
+    private:
+        // Distinct squared cuts in descending order and the one of every cluster
+        vector<float> cutsquares_;
+        vector<size_t> cut_of_;
+        vector<size_t> sizes_;
+        vector<unsigned int> sims_;
+        // Shared neighbors at which a frame maps onto a cluster
+        vector<size_t> min_shared_;
+        // Cluster of every point of the reduced data or -1
+        vector<int> cluster_of_;
+        bool any_empty_mapping_;
+        // Index of the members of the clusters of every cut and of all points
+        vector<nns::RadiusIndex> summaries_;
+        nns::RadiusIndex index_;
+    };
+
+    // USER INTERFACE STREAMING CLUSTERING
+    // Clustering of a stream of frames, e.g., of a long trajectory, within a
+    // sliding window of the most recent `window` frames. The frames are kept
+    // in a grid index from which they are removed as they leave. Only the
+    // edges whose shared neighbors changed are evaluated again, and only the
+    // clusters that gained or lost frames or similar edges are expanded anew,
+    // such that the window is clustered as by the deterministic mode. A
+    // cluster keeps its ID by the frames it shares with its former self or,
+    // once these left, by its `num_representatives` most connected frames,
+    // such that a state that is visited again gets its former ID. At most
+    // `max_ids` IDs keep representatives, and the least recently seen one is
+    // evicted first. Hence, the memory is bounded by the window and by
+    // `max_ids` times `num_representatives` frames.
+    template<class Similarity>
+    class StreamClustering {
+    public:
+        StreamClustering(const float cut,
+                         const unsigned int sim,
+                         const unsigned int Nkeep,
+                         const size_t window,
+                         const size_t num_representatives = 32,
+                         const size_t max_ids = 1024);
+
+        // Appends the frames to the window and returns their cluster IDs or
+        // -1 for noise. More frames than the window are added in parts.
+        vector<int> update(const vector<vector<float> > &frames);
+
+        // Cluster IDs of the frames of the window, the oldest first
+        vector<int> labels() const;
+
+        size_t size() const { return num_frames_; }
+
+        // IDs that were given so far and IDs that keep representatives
+        size_t num_ids() const { return next_id_; }
+
+        size_t num_kept_ids() const { return kept_.size(); }
+
+    private:
+        // Position of a frame of the stream in the buffers of the window
+        size_t slot(const size_t frame) const { return frame % window_size_; }
+
+        int label(const size_t frame) const;
+
+        bool similar(const size_t frame1,
+                     const size_t frame2) const;
+
+        void remove_oldest(const size_t num_frames);
+
+        void add(vector<vector<float> >::const_iterator first,
+                 vector<vector<float> >::const_iterator last);
+
+        void update_edges();
+
+        void recluster();
+
+        int choose_id(map<int, size_t> &votes,
+                      const vector<size_t> &cluster) const;
+
+        void represent(const int id,
+                       const vector<size_t> &cluster);
+
+        // Representatives of a kept ID and the update in which it was last seen
+        struct Kept {
+            size_t last_seen;
+            vector<vector<float> > points;
+        };
+
+        const float cut_;
+        const unsigned int sim_;
+        const unsigned int Nkeep_;
+        const size_t window_size_;
+        const size_t num_representatives_;
+        const size_t max_ids_;
+        // Policy on the frames of the window, created with the first frame
+        std::unique_ptr<Similarity> similarity_;
+        // Index of the oldest frame of the window in the stream and number of frames
+        size_t first_frame_;
+        size_t num_frames_;
+        size_t num_updates_;
+        // Frames, ascending neighbor lists and similar neighbors by the indices
+        // of the stream and component of every frame in a ring buffer of the
+        // window. Component 0 is no component, i.e., no similar neighbors.
+        vector<vector<float> > frames_;
+        vector<vector<size_t> > neighbors_;
+        vector<vector<size_t> > similar_;
+        vector<size_t> component_of_;
+        nns::GridIndex index_;
+        // ID of every component or -1 if it is too small to be a cluster
+        std::unordered_map<size_t, int> components_;
+        size_t next_component_;
+        // Work of an update: edges to evaluate, frames whose components
+        // changed and components of the frames that left
+        vector<std::pair<size_t, size_t> > candidates_;
+        vector<size_t> touched_;
+        vector<size_t> released_;
+        // Component of every ID in the window
+        std::unordered_map<int, size_t> active_;
+        // Kept IDs and the index of their representatives, whose
+        // ids are the ID times `num_representatives` plus their rank
+        std::unordered_map<int, Kept> kept_;
+        nns::GridIndex representatives_;
+        int next_id_;
+    };
 
     // USER INTERFACE MAPPING
     // Maps the data which was not used in a initial clustering step onto the exiting clusters
+    template<class Similarity>
     vector<vector<unsigned int> > cluster_mapping(vector<vector<unsigned int> > &clusters,
                                                   vector<vector<float> > &full_data,
                                                   vector<vector<float> > &reduced_data,
                                                   map<unsigned int, unsigned int> &frames,
-                                                  vector<clstep> &leaves,
-                                                  const unsigned int slice);
+                                                  vector<clstep> &leaves);
 
+    // USER INTERFACE HIERARCHY MAPPING
+    // Maps the data which was not used in a hierarchical clustering onto the leaves of its tree.
+    // A frame descends from the roots into the child onto which it maps best at the cut and
+    // similarity of the child, such that it is compared to the children of one branch per level
+    // instead of all leaves. Only a frame that reaches a leaf is mapped. The clusters of the
+    // leaves in depth-first order are returned and their steps are stored in `leaves`.
+    template<class Similarity>
+    vector<vector<unsigned int> > hierarchy_mapping(const Hierarchy &tree,
+                                                    vector<vector<float> > &full_data,
+                                                    vector<vector<float> > &reduced_data,
+                                                    map<unsigned int, unsigned int> &frames,
+                                                    vector<clstep> &leaves);
 };
 
+#include "clustering_impl.h"
+
 #endif //CNN_CLUSTERING_H
@@ -0,0 +1,1347 @@
+/*
+
+MIT License
+
+Copyright (c) 2020, R. Gregor Weiß, Benjamin Ries
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE
+*/
+
+#ifndef CNN_CLUSTERING_IMPL_H
+#define CNN_CLUSTERING_IMPL_H
+
+#include <iostream>
+#include <set>
+#include <functional> // std::greater
+#include <limits>
+#include <stdexcept>
+#include <numeric> // std::accumulate, std::iota
+#include <typeinfo>
+
+#include <omp.h>
+#include <parallel/algorithm>
+
+#include "cnn.h"
+#include "vs_cnn.h"
+#include "tools/utility.h"
+#include "tools/io.h"
+
+// Template definitions of clustering.h, included at its end
+
+namespace Clustering {
+
+    // Grows the tree by the new clusters of the leaves of a level, which
+    // are only given for the leaves that split, and freezes the branches
+    // whose clusters had at most 2 * Nkeep neighbor lists. The new nodes
+    // are appended to `treestream` if it is open.
+    void grow_hierarchy(Hierarchy &tree,
+                        vector<char> &active,
+                        const vector<size_t> &leaves,
+                        const vector<vector<vector<unsigned int> > > &hierarchic_clusters,
+                        const vector<size_t> &nghbrlst_szs,
+                        const clstep &step,
+                        const unsigned int Nkeep,
+                        ofstream &treestream,
+                        const float total_frames);
+
+    // Opens the tree file and, with `resume`, continues the tree, its
+    // active branches and the step of the next level from the checkpoint
+    // next to the tree file. Returns the checkpoint file, which is empty
+    // without a tree file, i.e., runs without a tree file do not resume.
+    string start_hierarchy(Hierarchy &tree,
+                           vector<char> &active,
+                           clstep &step,
+                           ofstream &treestream,
+                           const string &treefile,
+                           const uint64_t key,
+                           const bool resume);
+
+    // INTERFACE CLUSTERING
+    template<class Similarity>
+    vector<vector<unsigned int> >
+    clustering(vector<vector<float> > &data,
+               const float cut,
+               const unsigned int sim,
+               const int Nkeep,
+               const bool mutual,
+               const bool deterministic) {
+        // Obtain neighbor lists
+        Neighbors neighbor_lists;
+        Neighbors second_neighbor_lists;
+        if (mutual)
+            nns::neighbors(neighbor_lists, data, cut, 0);
+        else
+            nns::neighbors(neighbor_lists, second_neighbor_lists, data, cut, 0, mutual);
+
+        // Obtain clusters
+        return Clustering::Core::algorithm<Similarity>(data,
+                                                       neighbor_lists,
+                                                       second_neighbor_lists,
+                                                       cut,
+                                                       sim,
+                                                       Nkeep,
+                                                       mutual,
+                                                       deterministic);
+    }
+
+    // INTERFACE SIMILARITY SWEEP
+    template<class Similarity>
+    vector<vector<vector<unsigned int> > >
+    sweep(vector<vector<float> > &data,
+          const float cut,
+          const vector<unsigned int> &sims,
+          const int Nkeep) {
+        // Obtain neighbor lists
+        Neighbors neighbor_lists;
+        nns::neighbors(neighbor_lists, data, cut, 0);
+
+        // Obtain clusters for all similarities
+        return Clustering::Core::sweep<Similarity>(data, neighbor_lists, cut, sims, Nkeep);
+    }
+
+    // INTERFACE INCREMENTAL CLUSTERING
+    template<class Similarity>
+    vector<vector<unsigned int> >
+    incremental_clustering(vector<unsigned int> &components,
+                           vector<vector<float> > &data,
+                           const float cut,
+                           const unsigned int sim,
+                           const int Nkeep) {
+        const unsigned int num_old(components.size());
+        const unsigned int num_points(data.size());
+        if (num_old > num_points)
+            throw std::invalid_argument("The components comprise more points than the data.");
+        const unsigned int num_new(num_points - num_old);
+        const float cutsquare(cut * cut);
+
+        // Neighbor lists as of nns::neighbors, but of single points only
+        const nns::RadiusIndex index(data);
+        auto neighbor_list = [&](const unsigned int point) {
+            vector<unsigned int> neighbors_i;
+            index.radius(data[point], cutsquare, [&neighbors_i, point](const unsigned int neighbor, const float) {
+                if (neighbor != point) { neighbors_i.push_back(neighbor); }
+            });
+            __gnu_parallel::sort(neighbors_i.begin(), neighbors_i.end(), __gnu_parallel::sequential_tag());
+            return neighbors_i;
+        };
+
+        // Only the lists of the new points and of their old neighbors, whose
+        // lists grow, are needed, since the shared neighbors of all other
+        // edges stay the same
+        vector<vector<unsigned int> > new_lists(num_new);
+        Clustering::Utility::parallel_tasks(num_new, 16, [&](const size_t i) {
+            new_lists[i] = neighbor_list(num_old + i);
+        });
+        vector<unsigned int> grown;
+        vector<char> is_grown(num_old, 0);
+        for (auto const &neighbors_i : new_lists)
+            for (auto const &neighbor : neighbors_i)
+                if (neighbor < num_old && !is_grown[neighbor]) {
+                    is_grown[neighbor] = 1;
+                    grown.push_back(neighbor);
+                }
+        vector<vector<unsigned int> > grown_lists(grown.size());
+        Clustering::Utility::parallel_tasks(grown.size(), 16, [&](const size_t i) {
+            grown_lists[i] = neighbor_list(grown[i]);
+        });
+        Neighbors neighbors_ij;
+        for (unsigned int i = 0; i < num_new; i++)
+            if (!new_lists[i].empty()) { neighbors_ij[num_old + i] = std::move(new_lists[i]); }
+        for (size_t i = 0; i < grown.size(); i++)
+            neighbors_ij[grown[i]] = std::move(grown_lists[i]);
+
+        // Edges whose similarity may have changed: the edges of the new
+        // points and the edges between two old neighbors of a new point,
+        // which gained it as shared neighbor, unless they are connected
+        vector<std::pair<unsigned int, unsigned int> > candidates;
+        for (auto it = neighbors_ij.lower_bound(num_old); it != neighbors_ij.end(); ++it) {
+            const unsigned int point(it->first);
+            const vector<unsigned int> &neighbors_i = it->second;
+            for (auto const &neighbor : neighbors_i)
+                if (neighbor < point) { candidates.emplace_back(neighbor, point); }
+            const auto old_end = std::lower_bound(neighbors_i.begin(), neighbors_i.end(), num_old);
+            for (auto a = neighbors_i.begin(); a != old_end; ++a) {
+                const vector<unsigned int> &neighbors_a = neighbors_ij.at(*a);
+                for (auto b = a + 1; b != old_end; ++b)
+                    if (components[*a] != components[*b] &&
+                        std::binary_search(neighbors_a.begin(), neighbors_a.end(), *b))
+                        candidates.emplace_back(*a, *b);
+            }
+        }
+        __gnu_parallel::sort(candidates.begin(), candidates.end());
+        candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+        // Candidates are evaluated as by Core::algorithm
+        Similarity policy(data, cut, sim);
+        Graph graph;
+        nns::graph(graph, neighbors_ij);
+        if (Similarity::distance_dependent)
+            nns::distances(graph, data);
+        const Core::CachedSimilarity<Similarity> similarity(policy, graph);
+        vector<char> similar(candidates.size(), 0);
+        Clustering::Utility::parallel_tasks(candidates.size(), 64, [&](const size_t i) {
+            similar[i] = similarity(neighbors_ij, candidates[i].first, candidates[i].second);
+        });
+
+        // Similar edges stay similar, since shared neighbors are only added,
+        // thus, the components of the old points only merge
+        Clustering::Utility::DisjointSet sets(num_points);
+        for (unsigned int point = 0; point < num_old; point++)
+            sets.unite(point, components[point]);
+        for (size_t i = 0; i < candidates.size(); i++)
+            if (similar[i]) { sets.unite(candidates[i].first, candidates[i].second); }
+
+        // Every component is labeled by its smallest point and the clusters
+        // are the components with similar edges, as in the deterministic mode
+        components.resize(num_points);
+        vector<int> cluster_of_root(num_points, -1);
+        vector<vector<unsigned int> > clusters;
+        for (unsigned int point = 0; point < num_points; point++) {
+            const unsigned int root(sets.find(point));
+            if (cluster_of_root[root] < 0) {
+                cluster_of_root[root] = clusters.size();
+                clusters.emplace_back();
+            }
+            vector<unsigned int> &cluster = clusters[cluster_of_root[root]];
+            components[point] = cluster.empty() ? point : cluster.front();
+            cluster.push_back(point);
+        }
+        clusters.erase(std::remove_if(clusters.begin(), clusters.end(),
+                                      [](const vector<unsigned int> &cluster) { return cluster.size() < 2; }),
+                       clusters.end());
+        Clustering::Utility::sortNclean(clusters, Nkeep, true);
+        return clusters;
+    }
+
+    // Key of the checkpoints of a hierarchical clustering, i.e., the hash
+    // of its data, its parameters and its initial tree. Fast and
+    // deterministic runs share their checkpoints, since their trees agree.
+    template<class Similarity>
+    uint64_t checkpoint_key(const Hierarchy &tree,
+                            const vector<vector<float> > &data,
+                            const float delta_fe,
+                            const unsigned int ndims,
+                            const unsigned int Nkeep,
+                            const unsigned int Nsplit,
+                            const bool mutual,
+                            const bool deterministic) {
+        const string policy(typeid(Similarity).name());
+        const float parameters[] = {delta_fe, static_cast<float>(ndims), static_cast<float>(Nkeep),
+                                    static_cast<float>(Nsplit), static_cast<float>(mutual),
+                                    static_cast<float>(deterministic)};
+        uint64_t key(data_hash(data));
+        key = hash_bytes(policy.data(), policy.size(), key);
+        key = hash_bytes(parameters, sizeof(parameters), key);
+        for (auto const &node : tree.nodes) {
+            const int64_t parent(node.parent);
+            const uint64_t size(node.size());
+            key = hash_bytes(&parent, sizeof(parent), key);
+            key = hash_bytes(&node.step.cut, sizeof(node.step.cut), key);
+            key = hash_bytes(&node.step.sim, sizeof(node.step.sim), key);
+            key = hash_bytes(&size, sizeof(size), key);
+        }
+        return hash_bytes(tree.members.data(), tree.members.size() * sizeof(unsigned int), key);
+    }
+
+    // INTERFACE HIERARCHICAL CLUSTERING
+    template<class Similarity>
+    void hierarchical_clustering(Hierarchy &tree,
+                                 vector<vector<float> > &data,
+                                 const float delta_fe,
+                                 const unsigned int ndims,
+                                 const unsigned int Nkeep,
+                                 const unsigned int Nsplit,
+                                 const bool mutual,
+                                 const bool deterministic,
+                                 const string &treefile,
+                                 const bool resume) {
+        const float bfactor(std::exp(-delta_fe / ndims));
+        clstep step = tree.nodes.empty() ? clstep() : tree.nodes[0].step;
+        // A branch is frozen once its cluster has too few neighbor lists,
+        // since they only become fewer with the cut on the following levels.
+        vector<char> active(tree.nodes.size(), 1);
+        const uint64_t key(treefile.empty() ? 0 : checkpoint_key<Similarity>(tree, data, delta_fe, ndims, Nkeep,
+                                                                               Nsplit, mutual, deterministic));
+        ofstream treestream;
+        const string checkpointfile(start_hierarchy(tree, active, step, treestream, treefile, key, resume));
+
+//#ifdef ENABLE_DEBUG_MACRO
+        auto total_frames = static_cast<float>(data.size());
+        cout << " HIERARCHICAL FREE ENERGY PLAN " << endl;
+        cout << "\tSTEP\tFE\tCUT\tSIM " << endl;
+//#endif
+        // Neighbors of the points to split within the cut or, if not mutual,
+        // twice the cut. The cut and the clusters only shrink from level to
+        // level, thus, the graph of a level follows from the previous one.
+        Graph level_graph;
+        float level_radiussquare(-1.0f);
+        bool enough_neighbor_lists = std::any_of(active.begin(),
+                                                 active.end(),
+                                                 [](char branch) { return branch != 0; });
+        while (enough_neighbor_lists) {
+            // The clusters of the level are the leaves of the tree
+            const vector<size_t> leaves(tree.leaves());
+            vector<vector<unsigned int> > splits;
+            vector<size_t> split_of(leaves.size(), leaves.size());
+            for (size_t leaf_idx = 0; leaf_idx < leaves.size(); leaf_idx++)
+                if (active[leaves[leaf_idx]] && tree.nodes[leaves[leaf_idx]].size() > Nsplit) {
+                    split_of[leaf_idx] = splits.size();
+                    splits.push_back(tree.cluster(leaves[leaf_idx]));
+                }
+            const float cutsquare(step.cut * step.cut);
+            const float radiussquare(mutual ? cutsquare : 4.0f * cutsquare);
+            if (level_radiussquare < 0.0f || radiussquare > level_radiussquare)
+                nns::cluster_graph(level_graph, splits, data, radiussquare);
+            else
+                nns::filter_graph(level_graph, splits, radiussquare);
+            level_radiussquare = radiussquare;
+
+            // Initialize break criteria.
+            vector<size_t> nghbrlst_szs(leaves.size(), 0);
+            // Initialize data for hierarchical level.
+            vector<vector<vector<unsigned int> > > hierarchic_clusters(leaves.size());
+
+            // Largest clusters first, such that the level does not end with
+            // a large cluster running alone. A cluster of less than a thread's
+            // share of the level runs single-threaded next to the others,
+            // while larger ones spread their inner work over the team.
+            vector<size_t> schedule;
+            for (size_t leaf_idx = 0; leaf_idx < leaves.size(); leaf_idx++)
+                if (split_of[leaf_idx] < splits.size()) schedule.push_back(leaf_idx);
+            std::sort(schedule.begin(), schedule.end(), [&tree, &leaves](const size_t a, const size_t b) {
+                const size_t size_a(tree.nodes[leaves[a]].size()), size_b(tree.nodes[leaves[b]].size());
+                return size_a > size_b || (size_a == size_b && a < b);
+            });
+            size_t level_points(0);
+            for (auto const &cluster : splits)
+                level_points += cluster.size();
+            const size_t num_threads(omp_get_max_threads());
+
+            // Each cluster is a task whose inner work shares the same threads
+            Clustering::Utility::parallel_tasks(schedule.size(), 1, [&](const size_t task) {
+                const size_t leaf_idx = schedule[task];
+                const vector<unsigned int> &cluster = splits[split_of[leaf_idx]];
+                const bool large(cluster.size() * num_threads > level_points);
+                Clustering::Utility::ThreadBudget budget(large ? static_cast<int>(num_threads) : 1);
+
+                Neighbors neighbors_ij;
+                Neighbors second_neighbors_ij;
+                nns::neighbors_from_graph(neighbors_ij,
+                                          second_neighbors_ij,
+                                          cluster,
+                                          level_graph,
+                                          step.cut,
+                                          0,
+                                          mutual);
+                nghbrlst_szs[leaf_idx] = neighbors_ij.size();
+
+                // A split whose lists are short compared to the data is
+                // renumbered into a dense subproblem of the members and
+                // their neighbors, i.e., a halo of outside points, such
+                // that the core works on local data and on arrays of the
+                // size of the split instead of the size of the data.
+                size_t entries(0);
+                for (auto const *lists : {&neighbors_ij, &second_neighbors_ij})
+                    for (auto const &list : *lists)
+                        entries += list.second.size();
+                const bool local(entries < data.size());
+                vector<unsigned int> points;
+                vector<vector<float> > local_data;
+                if (local) {
+                    nns::compact(neighbors_ij, second_neighbors_ij, points);
+                    local_data.resize(points.size());
+                    for (size_t i = 0; i < points.size(); i++)
+                        local_data[i] = data[points[i]];
+                }
+
+                vector<vector<unsigned int> > new_clusters;
+                new_clusters = Clustering::Core::algorithm<Similarity>(local ? local_data : data,
+                                                                       neighbors_ij,
+                                                                       second_neighbors_ij,
+                                                                       step.cut,
+                                                                       step.sim,
+                                                                       Nkeep,
+                                                                       mutual,
+                                                                       deterministic);
+                if (local)
+                    for (auto &new_cluster : new_clusters)
+                        for (auto &point : new_cluster)
+                            point = points[point];
+
+                // only a cluster which splits obtains children
+                if (new_clusters.size() > 1)
+                    hierarchic_clusters[leaf_idx] = std::move(new_clusters);
+            });
+
+            // growing the tree after parallel loop
+            grow_hierarchy(tree, active, leaves, hierarchic_clusters, nghbrlst_szs, step, Nkeep, treestream,
+                           total_frames);
+
+            // Setting cutoff for next hierarchical level
+            step.cut = step.cut * bfactor;
+            step.step++;
+            if (!checkpointfile.empty())
+                write_checkpoint(checkpointfile, key, tree, active, step);
+
+            // Stopping criteria
+            enough_neighbor_lists = std::any_of(active.begin(),
+                                                active.end(),
+                                                [](char branch) { return branch != 0; });
+        }
+//#ifdef ENABLE_DEBUG_MACRO
+        std::cout << "Total # frames " << total_frames << std::endl;
+//#endif
+    }
+
+    // INTERFACE FAST HIERARCHICAL CLUSTERING
+    template<class Similarity>
+    void fast_hierarchical_clustering(Hierarchy &tree,
+                                      vector<vector<float> > &data,
+                                      const float delta_fe,
+                                      const unsigned int ndims,
+                                      const unsigned int Nkeep,
+                                      const unsigned int Nsplit,
+                                      const bool mutual,
+                                      const string &treefile,
+                                      const bool resume) {
+        // Only a shrinking cut keeps all levels within the first graph and
+        // only mutual pairs are its edges
+        if (!mutual || delta_fe <= 0.0f || tree.nodes.empty()) {
+            hierarchical_clustering<Similarity>(tree, data, delta_fe, ndims, Nkeep, Nsplit, mutual, true, treefile,
+                                                resume);
+            return;
+        }
+        const float bfactor(std::exp(-delta_fe / ndims));
+        clstep step = tree.nodes[0].step;
+        vector<char> active(tree.nodes.size(), 1);
+        const uint64_t key(treefile.empty() ? 0 : checkpoint_key<Similarity>(tree, data, delta_fe, ndims, Nkeep,
+                                                                               Nsplit, mutual, true));
+        ofstream treestream;
+        const string checkpointfile(start_hierarchy(tree, active, step, treestream, treefile, key, resume));
+
+//#ifdef ENABLE_DEBUG_MACRO
+        auto total_frames = static_cast<float>(data.size());
+        cout << " FAST HIERARCHICAL FREE ENERGY PLAN " << endl;
+        cout << "\tSTEP\tFE\tCUT\tSIM " << endl;
+//#endif
+
+        // The graph of the first level holds the neighbors of all levels.
+        // Neither policy asks for more than `sim` shared neighbors, hence,
+        // the cuts at which the first `sim` shared neighbors of an edge
+        // appear decide the edge on every level.
+        vector<vector<unsigned int> > splits;
+        vector<char> members(data.size(), 0);
+        for (auto const &leaf : tree.leaves()) {
+            splits.push_back(tree.cluster(leaf));
+            for (auto const &point : splits.back())
+                members[point] = 1;
+        }
+        const unsigned int depth(step.sim);
+        vector<std::pair<unsigned int, unsigned int> > pairs;
+        vector<float> shared_cuts;
+        vector<float> pair_cuts;
+        vector<float> distances;
+        vector<float> nearest(data.size(), std::numeric_limits<float>::infinity());
+        {
+            Graph graph;
+            nns::cluster_graph(graph, splits, data, step.cut * step.cut);
+            Clustering::Core::shared_neighbor_cuts(pairs, shared_cuts, graph, members, depth);
+
+            pair_cuts.resize(pairs.size());
+            if (Similarity::distance_dependent)
+                distances.resize(pairs.size());
+            Clustering::Utility::parallel_tasks(pairs.size(), 256, [&](const size_t pair) {
+                const unsigned int point(pairs[pair].first), neighbor(pairs[pair].second);
+                pair_cuts[pair] = graph.distances[graph.edge(point, neighbor)];
+                if (Similarity::distance_dependent)
+                    distances[pair] = nns::distance(data[point], data[neighbor]);
+            });
+            // A point has a neighbor list as long as the cut reaches its nearest neighbor
+            for (unsigned int point = 0; point < graph.num_points(); point++)
+                for (size_t edge = graph.offsets[point]; edge < graph.offsets[point + 1]; edge++)
+                    nearest[point] = std::min(nearest[point], graph.distances[edge]);
+        }
+        splits.clear();
+
+        vector<size_t> candidates(pairs.size());
+        std::iota(candidates.begin(), candidates.end(), 0);
+        vector<long> leaf_of(data.size(), -1);
+        bool enough_neighbor_lists = std::any_of(active.begin(),
+                                                 active.end(),
+                                                 [](char branch) { return branch != 0; });
+        while (enough_neighbor_lists) {
+            const vector<size_t> leaves(tree.leaves());
+            vector<char> splitting(leaves.size(), 0);
+            std::fill(leaf_of.begin(), leaf_of.end(), -1);
+            for (size_t leaf_idx = 0; leaf_idx < leaves.size(); leaf_idx++) {
+                const HierarchyNode &node = tree.nodes[leaves[leaf_idx]];
+                splitting[leaf_idx] = active[leaves[leaf_idx]] && node.size() > Nsplit;
+                if (splitting[leaf_idx])
+                    for (size_t member = node.begin; member < node.end; member++)
+                        leaf_of[tree.members[member]] = leaf_idx;
+            }
+            const float cutsquare(step.cut * step.cut);
+
+            // Pairs that left the cut or a split never return
+            candidates.erase(std::remove_if(candidates.begin(), candidates.end(), [&](const size_t pair) {
+                const long leaf(leaf_of[pairs[pair].first]);
+                return leaf < 0 || leaf != leaf_of[pairs[pair].second] || pair_cuts[pair] > cutsquare;
+            }), candidates.end());
+
+            // Similar pairs of the level by an integer threshold per pair
+            Similarity similarity(data, step.cut, step.sim);
+            vector<char> similar(candidates.size(), 0);
+            Clustering::Utility::parallel_tasks(candidates.size(), 1024, [&](const size_t i) {
+                const size_t pair(candidates[i]);
+                const unsigned int threshold(similarity.threshold(distances.empty() ? 0.0f : distances[pair]));
+                similar[i] = (threshold == 0 || shared_cuts[pair * depth + threshold - 1] <= cutsquare);
+            });
+            Clustering::Utility::DisjointSet components(data.size());
+            for (size_t i = 0; i < candidates.size(); i++)
+                if (similar[i])
+                    components.unite(pairs[candidates[i]].first, pairs[candidates[i]].second);
+
+            // The clusters of a split are the components of its members
+            vector<size_t> nghbrlst_szs(leaves.size(), 0);
+            vector<vector<vector<unsigned int> > > hierarchic_clusters(leaves.size());
+            for (size_t leaf_idx = 0; leaf_idx < leaves.size(); leaf_idx++) {
+                if (!splitting[leaf_idx]) { continue; }
+                vector<unsigned int> cluster(tree.cluster(leaves[leaf_idx]));
+                std::sort(cluster.begin(), cluster.end());
+                std::map<unsigned int, size_t> cluster_of_root;
+                vector<vector<unsigned int> > new_clusters;
+                for (auto const &point : cluster) {
+                    if (nearest[point] <= cutsquare) { nghbrlst_szs[leaf_idx]++; }
+                    if (components.size(point) < 2) { continue; }
+                    auto it = cluster_of_root.emplace(components.find(point), new_clusters.size()).first;
+                    if (it->second == new_clusters.size())
+                        new_clusters.emplace_back();
+                    new_clusters[it->second].push_back(point);
+                }
+                Clustering::Utility::sortNclean(new_clusters, Nkeep, true);
+
+                // only a cluster which splits obtains children
+                if (new_clusters.size() > 1)
+                    hierarchic_clusters[leaf_idx] = std::move(new_clusters);
+            }
+
+            grow_hierarchy(tree, active, leaves, hierarchic_clusters, nghbrlst_szs, step, Nkeep, treestream,
+                           total_frames);
+
+            // Setting cutoff for next hierarchical level
+            step.cut = step.cut * bfactor;
+            step.step++;
+            if (!checkpointfile.empty())
+                write_checkpoint(checkpointfile, key, tree, active, step);
+
+            // Stopping criteria
+            enough_neighbor_lists = std::any_of(active.begin(),
+                                                active.end(),
+                                                [](char branch) { return branch != 0; });
+        }
+//#ifdef ENABLE_DEBUG_MACRO
+        std::cout << "Total # frames " << total_frames << std::endl;
+//#endif
+    }
+
+    template<class Similarity>
+    vector<clstep>
+    hierarchical_clustering(vector<vector<unsigned int> > &clusters,
+                            vector<vector<float> > &data,
+                            const clstep init_step,
+                            const float delta_fe,
+                            const unsigned int ndims,
+                            const unsigned int Nkeep,
+                            const unsigned int Nsplit,
+                            const bool mutual,
+                            const bool deterministic) {
+        Hierarchy tree;
+        tree.add_roots(clusters, init_step);
+        clusters.clear();
+        hierarchical_clustering<Similarity>(tree, data, delta_fe, ndims, Nkeep, Nsplit, mutual, deterministic, "");
+
+        vector<clstep> leaves;
+        clusters = tree.leaf_clusters(leaves);
+        return leaves;
+    }
+
+    // USER INTERFACE ONLINE ASSIGNMENT
+    template<class Similarity>
+    Assigner<Similarity>::Assigner(const vector<vector<unsigned int> > &clusters,
+                                   const vector<vector<float> > &reduced_data,
+                                   const vector<clstep> &leaves) :
+            cut_of_(clusters.size()), sizes_(clusters.size()), sims_(clusters.size()),
+            min_shared_(clusters.size()), cluster_of_(reduced_data.size(), -1), index_(reduced_data) {
+
+        // Distinct cuts of the leaves in descending order
+        for (auto const &leaf : leaves)
+            cutsquares_.push_back(leaf.cut * leaf.cut);
+        std::sort(cutsquares_.begin(), cutsquares_.end(), std::greater<float>());
+        cutsquares_.erase(std::unique(cutsquares_.begin(), cutsquares_.end()), cutsquares_.end());
+        for (unsigned int cluster_idx = 0; cluster_idx < clusters.size(); cluster_idx++) {
+            const float cutsquare(leaves[cluster_idx].cut * leaves[cluster_idx].cut);
+            cut_of_[cluster_idx] = std::find(cutsquares_.begin(), cutsquares_.end(), cutsquare) - cutsquares_.begin();
+            sizes_[cluster_idx] = clusters[cluster_idx].size();
+            sims_[cluster_idx] = leaves[cluster_idx].sim;
+            // The mapping criterion only grows with the shared neighbors,
+            // thus, it is a threshold, which exceeds the size if never met
+            const Similarity similarity(reduced_data, leaves[cluster_idx].cut, leaves[cluster_idx].sim);
+            size_t shared(0);
+            while (shared <= sizes_[cluster_idx] && !similarity.mapping(shared)) { shared++; }
+            min_shared_[cluster_idx] = shared;
+            for (auto const &point : clusters[cluster_idx])
+                cluster_of_[point] = cluster_idx;
+        }
+        any_empty_mapping_ = std::find(min_shared_.begin(), min_shared_.end(), 0) != min_shared_.end();
+
+        // Summary of the clusters of every distinct cut: an index of the
+        // members of the clusters that a frame can be mapped onto at all,
+        // i.e., which are large enough to hold the shared neighbors. The
+        // other clusters and the noise are rejected without any query.
+        vector<vector<unsigned int> > summary_points(cutsquares_.size());
+        for (unsigned int cluster_idx = 0; cluster_idx < clusters.size(); cluster_idx++)
+            if (min_shared_[cluster_idx] <= sizes_[cluster_idx])
+                summary_points[cut_of_[cluster_idx]].insert(summary_points[cut_of_[cluster_idx]].end(),
+                                                            clusters[cluster_idx].begin(),
+                                                            clusters[cluster_idx].end());
+        summaries_.reserve(cutsquares_.size());
+        for (auto const &points : summary_points)
+            summaries_.emplace_back(reduced_data, points);
+    }
+
+    // A frame is assigned onto the cluster that holds the largest
+    // fraction of its members as neighbors, the first one on ties
+    template<class Similarity>
+    int Assigner<Similarity>::assign(const vector<float> &frame) const {
+        if (cutsquares_.empty()) { return -1; }
+        // Dense counts of the neighbors of the frame per cluster, each
+        // within the cut of its cluster
+        thread_local vector<unsigned int> shared;
+        thread_local vector<long> within;
+        thread_local vector<unsigned int> touched;
+        shared.assign(sizes_.size(), 0);
+        within.assign(cutsquares_.size(), -1);
+        touched.clear();
+
+        for (size_t cut = 0; cut < cutsquares_.size(); ++cut)
+            summaries_[cut].radius(frame, cutsquares_[cut], [&](const unsigned int point, const float) {
+                const int cluster_idx(cluster_of_[point]);
+                if (shared[cluster_idx]++ == 0) { touched.push_back(cluster_idx); }
+            });
+
+        // Clusters without neighbors are only candidates if they map without shared neighbors
+        if (any_empty_mapping_) {
+            touched.resize(sizes_.size());
+            std::iota(touched.begin(), touched.end(), 0);
+        } else {
+            std::sort(touched.begin(), touched.end());
+        }
+        int assigned(-1);
+        float best(-1.0f);
+        for (auto const &cluster_idx : touched) {
+            if (shared[cluster_idx] < min_shared_[cluster_idx]) { continue; }
+            // Only a neighbor list of more than `sim` neighbors is considered.
+            // The shared neighbors are within the cut, thus, all neighbors
+            // are only counted if there are too few shared ones.
+            const size_t cut(cut_of_[cluster_idx]);
+            if (shared[cluster_idx] < sims_[cluster_idx] + 1) {
+                if (within[cut] < 0) {
+                    within[cut] = 0;
+                    index_.radius(frame, cutsquares_[cut], [&](const unsigned int, const float) { within[cut]++; });
+                }
+                if (within[cut] < static_cast<long>(sims_[cluster_idx]) + 1) { continue; }
+            }
+            float sim_f = static_cast<float>(shared[cluster_idx]);
+            float size_f = static_cast<float>(sizes_[cluster_idx]);
+            if (sim_f / size_f > best) {
+                best = sim_f / size_f;
+                assigned = static_cast<int>(cluster_idx);
+            }
+        }
+        return assigned;
+    }
+
+    template<class Similarity>
+    vector<int> Assigner<Similarity>::assign(const vector<vector<float> > &frames) const {
+        vector<int> assigned(frames.size(), -1);
+        Clustering::Utility::parallel_tasks(frames.size(), 64, [&](const size_t frame) {
+            assigned[frame] = assign(frames[frame]);
+        });
+        return assigned;
+    }
+
+    // USER INTERFACE STREAMING CLUSTERING
+    template<class Similarity>
+    StreamClustering<Similarity>::StreamClustering(const float cut,
+                                                   const unsigned int sim,
+                                                   const unsigned int Nkeep,
+                                                   const size_t window,
+                                                   const size_t num_representatives,
+                                                   const size_t max_ids) :
+            cut_(cut), sim_(sim), Nkeep_(Nkeep), window_size_(window),
+            num_representatives_(num_representatives), max_ids_(max_ids),
+            first_frame_(0), num_frames_(0), num_updates_(0),
+            frames_(window), neighbors_(window), similar_(window), component_of_(window, 0),
+            index_(cut), next_component_(1), representatives_(cut), next_id_(0) {
+        if (window == 0)
+            throw std::invalid_argument("The window must hold at least one frame.");
+    }
+
+    template<class Similarity>
+    vector<int> StreamClustering<Similarity>::update(const vector<vector<float> > &frames) {
+        vector<int> ids;
+        ids.reserve(frames.size());
+        for (size_t begin = 0; begin < frames.size(); begin += window_size_) {
+            const size_t num_frames(std::min(window_size_, frames.size() - begin));
+            if (num_frames_ + num_frames > window_size_)
+                remove_oldest(num_frames_ + num_frames - window_size_);
+            add(frames.begin() + begin, frames.begin() + begin + num_frames);
+            update_edges();
+            recluster();
+            for (size_t frame = first_frame_ + num_frames_ - num_frames; frame < first_frame_ + num_frames_; frame++)
+                ids.push_back(label(frame));
+        }
+        return ids;
+    }
+
+    template<class Similarity>
+    vector<int> StreamClustering<Similarity>::labels() const {
+        vector<int> labels;
+        labels.reserve(num_frames_);
+        for (size_t frame = first_frame_; frame < first_frame_ + num_frames_; frame++)
+            labels.push_back(label(frame));
+        return labels;
+    }
+
+    template<class Similarity>
+    int StreamClustering<Similarity>::label(const size_t frame) const {
+        const size_t component(component_of_[slot(frame)]);
+        return (component == 0) ? -1 : components_.at(component);
+    }
+
+    // Similarity of two frames as evaluated by Core::algorithm
+    template<class Similarity>
+    bool StreamClustering<Similarity>::similar(const size_t frame1,
+                                               const size_t frame2) const {
+        const vector<size_t> &neighbors1 = neighbors_[slot(frame1)];
+        const vector<size_t> &neighbors2 = neighbors_[slot(frame2)];
+        size_t shared(0);
+        auto it1 = neighbors1.begin(), it2 = neighbors2.begin();
+        while (it1 != neighbors1.end() && it2 != neighbors2.end()) {
+            if (*it1 < *it2) {
+                ++it1;
+            } else if (*it2 < *it1) {
+                ++it2;
+            } else {
+                ++shared;
+                ++it1;
+                ++it2;
+            }
+        }
+        if (Similarity::distance_dependent)
+            return shared >= similarity_->threshold(nns::distance(frames_[slot(frame1)], frames_[slot(frame2)]));
+        return (*similarity_)(shared, slot(frame1), slot(frame2));
+    }
+
+    // The oldest frames are the first neighbors of all of their neighbors.
+    // The similar edges between two of their neighbors lose a shared neighbor.
+    template<class Similarity>
+    void StreamClustering<Similarity>::remove_oldest(const size_t num_frames) {
+        for (size_t frame = first_frame_; frame < first_frame_ + num_frames; frame++) {
+            const size_t position(slot(frame));
+            index_.remove(frame, frames_[position]);
+
+            const vector<size_t> &neighbors_i = neighbors_[position];
+            for (auto a = neighbors_i.begin(); a != neighbors_i.end(); ++a) {
+                vector<size_t> &neighbors_a = neighbors_[slot(*a)];
+                neighbors_a.erase(neighbors_a.begin());
+                const vector<size_t> &similar_a = similar_[slot(*a)];
+                for (auto b = a + 1; b != neighbors_i.end(); ++b)
+                    if (std::binary_search(similar_a.begin(), similar_a.end(), *b))
+                        candidates_.emplace_back(*a, *b);
+            }
+            for (auto const &neighbor : similar_[position]) {
+                vector<size_t> &similar_a = similar_[slot(neighbor)];
+                similar_a.erase(similar_a.begin());
+                touched_.push_back(neighbor);
+            }
+            if (component_of_[position] != 0) { released_.push_back(component_of_[position]); }
+
+            neighbors_[position].clear();
+            similar_[position].clear();
+            component_of_[position] = 0;
+        }
+        first_frame_ += num_frames;
+        num_frames_ -= num_frames;
+    }
+
+    // New frames are the last neighbors of all of their neighbors, such that
+    // the lists stay sorted. Their edges and the edges between two of their
+    // neighbors, which gain a shared neighbor, are evaluated unless similar.
+    template<class Similarity>
+    void StreamClustering<Similarity>::add(vector<vector<float> >::const_iterator first,
+                                           vector<vector<float> >::const_iterator last) {
+        const size_t first_new(first_frame_ + num_frames_);
+        const size_t num_new(last - first);
+        for (size_t i = 0; i < num_new; i++) {
+            frames_[slot(first_new + i)] = *(first + i);
+            index_.insert(first_new + i, frames_[slot(first_new + i)]);
+        }
+        num_frames_ += num_new;
+        if (!similarity_) { similarity_.reset(new Similarity(frames_, cut_, sim_)); }
+        const float cutsquare(cut_ * cut_);
+
+        vector<vector<size_t> > earlier(num_new);
+        Clustering::Utility::parallel_tasks(num_new, 16, [&](const size_t i) {
+            const size_t frame(first_new + i);
+            index_.radius(frames_[slot(frame)], cutsquare, [&](const size_t neighbor, const float) {
+                if (neighbor < frame) { earlier[i].push_back(neighbor); }
+            });
+            __gnu_parallel::sort(earlier[i].begin(), earlier[i].end(), __gnu_parallel::sequential_tag());
+        });
+        for (size_t i = 0; i < num_new; i++) {
+            const size_t frame(first_new + i);
+            const vector<size_t> &neighbors_i = earlier[i];
+            for (auto a = neighbors_i.begin(); a != neighbors_i.end(); ++a) {
+                const vector<size_t> &neighbors_a = neighbors_[slot(*a)];
+                const vector<size_t> &similar_a = similar_[slot(*a)];
+                for (auto b = a + 1; b != neighbors_i.end(); ++b)
+                    if (std::binary_search(neighbors_a.begin(), neighbors_a.end(), *b) &&
+                        !std::binary_search(similar_a.begin(), similar_a.end(), *b))
+                        candidates_.emplace_back(*a, *b);
+                candidates_.emplace_back(*a, frame);
+            }
+            for (auto const &neighbor : neighbors_i)
+                neighbors_[slot(neighbor)].push_back(frame);
+            neighbors_[slot(frame)] = std::move(earlier[i]);
+            touched_.push_back(frame);
+        }
+    }
+
+    // Candidates are evaluated on the lists after the update and the
+    // endpoints of every edge that became (dis)similar are touched
+    template<class Similarity>
+    void StreamClustering<Similarity>::update_edges() {
+        candidates_.erase(std::remove_if(candidates_.begin(), candidates_.end(),
+                                         [this](const std::pair<size_t, size_t> &edge) {
+                                             return edge.first < first_frame_;
+                                         }),
+                          candidates_.end());
+        __gnu_parallel::sort(candidates_.begin(), candidates_.end());
+        candidates_.erase(std::unique(candidates_.begin(), candidates_.end()), candidates_.end());
+
+        vector<char> is_similar(candidates_.size(), 0);
+        Clustering::Utility::parallel_tasks(candidates_.size(), 64, [&](const size_t i) {
+            is_similar[i] = similar(candidates_[i].first, candidates_[i].second);
+        });
+        for (size_t i = 0; i < candidates_.size(); i++) {
+            const size_t a(candidates_[i].first), b(candidates_[i].second);
+            vector<size_t> &similar_a = similar_[slot(a)];
+            vector<size_t> &similar_b = similar_[slot(b)];
+            auto it_a = std::lower_bound(similar_a.begin(), similar_a.end(), b);
+            const bool was_similar(it_a != similar_a.end() && *it_a == b);
+            if (is_similar[i] == was_similar) { continue; }
+            auto it_b = std::lower_bound(similar_b.begin(), similar_b.end(), a);
+            if (is_similar[i]) {
+                similar_a.insert(it_a, b);
+                similar_b.insert(it_b, a);
+            } else {
+                similar_a.erase(it_a);
+                similar_b.erase(it_b);
+            }
+            touched_.push_back(a);
+            touched_.push_back(b);
+        }
+        candidates_.clear();
+    }
+
+    // The components of the touched frames are released and expanded anew
+    // over the similar edges, all other components stay as they are.
+    // Larger clusters choose their IDs first, as in a full reclustering.
+    template<class Similarity>
+    void StreamClustering<Similarity>::recluster() {
+        num_updates_++;
+        std::unordered_map<size_t, int> released_ids;
+        auto release = [&](const size_t component) {
+            auto it = components_.find(component);
+            if (it == components_.end()) { return; }
+            const int id(it->second);
+            released_ids[component] = id;
+            if (id >= 0) {
+                active_.erase(id);
+                auto kept = kept_.find(id);
+                if (kept != kept_.end()) { kept->second.last_seen = num_updates_; }
+            }
+            components_.erase(it);
+        };
+        for (auto const &component : released_)
+            release(component);
+        for (auto const &frame : touched_)
+            if (frame >= first_frame_) { release(component_of_[slot(frame)]); }
+
+        // Frames of the new components have components from `first_component` on
+        const size_t first_component(next_component_);
+        vector<vector<size_t> > clusters;
+        vector<size_t> keys;
+        vector<map<int, size_t> > votes;
+        for (auto const &frame : touched_) {
+            if (frame < first_frame_) { continue; }
+            const size_t position(slot(frame));
+            if (component_of_[position] >= first_component) { continue; }
+            if (similar_[position].empty()) {
+                component_of_[position] = 0;
+                continue;
+            }
+
+            const size_t component(next_component_++);
+            map<int, size_t> cluster_votes;
+            auto claim = [&](const size_t point) {
+                auto it = released_ids.find(component_of_[slot(point)]);
+                if (it != released_ids.end() && it->second >= 0) { cluster_votes[it->second]++; }
+                component_of_[slot(point)] = component;
+            };
+            vector<size_t> cluster(1, frame);
+            claim(frame);
+            for (size_t i = 0; i < cluster.size(); i++)
+                for (auto const &neighbor : similar_[slot(cluster[i])])
+                    if (component_of_[slot(neighbor)] < first_component) {
+                        claim(neighbor);
+                        cluster.push_back(neighbor);
+                    }
+            __gnu_parallel::sort(cluster.begin(), cluster.end(), __gnu_parallel::sequential_tag());
+            clusters.push_back(std::move(cluster));
+            keys.push_back(component);
+            votes.push_back(std::move(cluster_votes));
+        }
+        touched_.clear();
+        released_.clear();
+
+        vector<size_t> order(clusters.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&clusters](const size_t a, const size_t b) {
+            if (clusters[a].size() != clusters[b].size()) { return clusters[a].size() > clusters[b].size(); }
+            return clusters[a].front() < clusters[b].front();
+        });
+        for (auto const &cluster_idx : order) {
+            int id(-1);
+            if (clusters[cluster_idx].size() > Nkeep_) {
+                id = choose_id(votes[cluster_idx], clusters[cluster_idx]);
+                if (id == next_id_) { next_id_++; }
+                active_[id] = keys[cluster_idx];
+                represent(id, clusters[cluster_idx]);
+            }
+            components_[keys[cluster_idx]] = id;
+        }
+    }
+
+    // A cluster takes the ID that most of its frames had before, else the
+    // kept ID whose representatives are neighbors of at least `sim` of its
+    // frames, the lower ID on ties, else a new one. IDs in the window are taken.
+    template<class Similarity>
+    int StreamClustering<Similarity>::choose_id(map<int, size_t> &votes,
+                                                const vector<size_t> &cluster) const {
+        for (auto it = votes.begin(); it != votes.end();)
+            it = (active_.count(it->first) == 1) ? votes.erase(it) : std::next(it);
+        if (votes.empty() && num_representatives_ > 0) {
+            const float cutsquare(cut_ * cut_);
+            for (auto const &frame : cluster) {
+                std::set<int> near;
+                representatives_.radius(frames_[slot(frame)], cutsquare, [&](const size_t representative, const float) {
+                    const int id(representative / num_representatives_);
+                    if (active_.count(id) == 0) { near.insert(id); }
+                });
+                for (auto const &id : near)
+                    votes[id]++;
+            }
+            for (auto it = votes.begin(); it != votes.end();)
+                it = (it->second < sim_) ? votes.erase(it) : std::next(it);
+        }
+        int id(-1);
+        size_t most(0);
+        for (auto const &vote : votes)
+            if (vote.second > most) {
+                most = vote.second;
+                id = vote.first;
+            }
+        return (id < 0) ? next_id_ : id;
+    }
+
+    // The frames with the most neighbors represent a cluster. If `max_ids`
+    // IDs are kept, the least recently seen ID that is not in the window is
+    // evicted, or the cluster is not represented if there is none.
+    template<class Similarity>
+    void StreamClustering<Similarity>::represent(const int id,
+                                                 const vector<size_t> &cluster) {
+        if (num_representatives_ == 0) { return; }
+        auto forget = [this](typename std::unordered_map<int, Kept>::iterator kept) {
+            for (size_t rank = 0; rank < kept->second.points.size(); rank++)
+                representatives_.remove(kept->first * num_representatives_ + rank, kept->second.points[rank]);
+            kept->second.points.clear();
+        };
+        auto kept = kept_.find(id);
+        if (kept != kept_.end()) {
+            forget(kept);
+        } else {
+            if (kept_.size() >= max_ids_) {
+                auto evict = kept_.end();
+                for (auto it = kept_.begin(); it != kept_.end(); ++it) {
+                    if (active_.count(it->first) == 1) { continue; }
+                    if (evict == kept_.end() || it->second.last_seen < evict->second.last_seen ||
+                        (it->second.last_seen == evict->second.last_seen && it->first < evict->first))
+                        evict = it;
+                }
+                if (evict == kept_.end()) { return; }
+                forget(evict);
+                kept_.erase(evict);
+            }
+            kept = kept_.emplace(id, Kept()).first;
+        }
+        kept->second.last_seen = num_updates_;
+
+        vector<size_t> members(cluster);
+        const size_t num_kept(std::min(members.size(), num_representatives_));
+        std::partial_sort(members.begin(), members.begin() + num_kept, members.end(),
+                          [this](const size_t a, const size_t b) {
+                              const size_t size_a(neighbors_[slot(a)].size()), size_b(neighbors_[slot(b)].size());
+                              return size_a > size_b || (size_a == size_b && a < b);
+                          });
+        for (size_t rank = 0; rank < num_kept; rank++) {
+            kept->second.points.push_back(frames_[slot(members[rank])]);
+            representatives_.insert(id * num_representatives_ + rank, kept->second.points.back());
+        }
+    }
+
+    // USER INTERFACE MAPPING
+    // Maps the data which was not used in a initial clustering step onto the exiting cluster.
+    // Frames are processed in parallel and each of them is assigned as by an Assigner.
+    template<class Similarity>
+    vector<vector<unsigned int> > cluster_mapping(vector<vector<unsigned int> > &clusters,
+                                                  vector<vector<float> > &full_data,
+                                                  vector<vector<float> > &reduced_data,
+                                                  map<unsigned int, unsigned int> &frames,
+                                                  vector<clstep> &leaves) {
+
+        // Frames of the reduced data, i.e., the clustered data, are not mapped
+        vector<char> reduced_frame(full_data.size(), 0);
+        for (auto const &frame : frames)
+            if (frame.second < full_data.size()) { reduced_frame[frame.second] = 1; }
+
+        const Assigner<Similarity> assigner(clusters, reduced_data, leaves);
+        vector<int> mapped(full_data.size(), -1);
+        Clustering::Utility::parallel_tasks(full_data.size(), 64, [&](const size_t frame) {
+            if (!reduced_frame[frame]) { mapped[frame] = assigner.assign(full_data[frame]); }
+        });
+
+        // Current frames and clusters are scales down by slice;
+        // so scale it up to push the mapped points into the clusters
+        // in the preceding loop.
+        for (size_t i = 0; i < clusters.size(); ++i)
+            for (size_t j = 0; j < clusters[i].size(); ++j)
+                clusters[i][j] = frames[clusters[i][j]];
+
+        for (size_t frame = 0; frame < full_data.size(); ++frame)
+            if (mapped[frame] >= 0)
+                clusters[mapped[frame]].push_back(frame);
+
+        return clusters;
+    }
+
+    // USER INTERFACE HIERARCHY MAPPING
+    template<class Similarity>
+    vector<vector<unsigned int> > hierarchy_mapping(const Hierarchy &tree,
+                                                    vector<vector<float> > &full_data,
+                                                    vector<vector<float> > &reduced_data,
+                                                    map<unsigned int, unsigned int> &frames,
+                                                    vector<clstep> &leaves) {
+        // Frames of the reduced data, i.e., the clustered data, are not mapped
+        vector<char> reduced_frame(full_data.size(), 0);
+        for (auto const &frame : frames)
+            if (frame.second < full_data.size()) { reduced_frame[frame.second] = 1; }
+
+        // A point belongs to a node if its position in the members of the
+        // tree is within the range of the node
+        const size_t unset(std::numeric_limits<size_t>::max());
+        vector<size_t> position(reduced_data.size(), unset);
+        for (size_t pos = 0; pos < tree.members.size(); pos++)
+            position[tree.members[pos]] = pos;
+        vector<size_t> roots;
+        vector<Similarity> similarities;
+        similarities.reserve(tree.nodes.size());
+        float maxcutsquare(0.0f);
+        for (size_t node = 0; node < tree.nodes.size(); node++) {
+            const clstep &step = tree.nodes[node].step;
+            if (tree.nodes[node].parent < 0) { roots.push_back(node); }
+            similarities.emplace_back(reduced_data, step.cut, step.sim);
+            maxcutsquare = std::max(maxcutsquare, step.cut * step.cut);
+        }
+        const vector<size_t> leaf_nodes(tree.leaves());
+        vector<size_t> leaf_of(tree.nodes.size(), 0);
+        for (size_t leaf_idx = 0; leaf_idx < leaf_nodes.size(); leaf_idx++)
+            leaf_of[leaf_nodes[leaf_idx]] = leaf_idx;
+
+        // Every frame descends from the roots into the child that holds the
+        // largest fraction of its members as neighbors, the first one on ties.
+        // Candidates of a level own disjoint and ascending ranges of members.
+        std::sort(roots.begin(), roots.end(), [&tree](const size_t a, const size_t b) {
+            return tree.nodes[a].begin < tree.nodes[b].begin;
+        });
+        const bool any_empty_mapping(std::any_of(similarities.begin(), similarities.end(),
+                                                 [](const Similarity &similarity) { return similarity.mapping(0); }));
+        vector<long> mapped(full_data.size(), -1);
+        const nns::RadiusIndex index(reduced_data);
+        Clustering::Utility::parallel_tasks(full_data.size(), 64, [&](const size_t frame) {
+            if (reduced_frame[frame] || roots.empty()) { return; }
+            // Neighbors within the largest cut by their position in the tree
+            // and the distances of all neighbors, of which every cut of a
+            // node selects the ones within it
+            thread_local vector<std::pair<size_t, float> > nearby;
+            thread_local vector<float> distances;
+            thread_local vector<size_t> shared;
+            nearby.clear();
+            distances.clear();
+            index.radius(full_data[frame], maxcutsquare, [&](const unsigned int point, const float dist) {
+                distances.push_back(dist);
+                if (position[point] != unset) { nearby.emplace_back(position[point], dist); }
+            });
+            if (nearby.empty() && !any_empty_mapping) { return; }
+
+            const vector<size_t> *candidates = &roots;
+            vector<size_t> children;
+            while (true) {
+                shared.assign(candidates->size(), 0);
+                for (auto const &neighbor : nearby) {
+                    auto it = std::upper_bound(candidates->begin(), candidates->end(), neighbor.first,
+                                               [&tree](const size_t pos, const size_t node) {
+                                                   return pos < tree.nodes[node].begin;
+                                               });
+                    if (it == candidates->begin()) { continue; }
+                    const HierarchyNode &candidate = tree.nodes[*(it - 1)];
+                    if (neighbor.first < candidate.end && neighbor.second <= candidate.step.cut * candidate.step.cut)
+                        shared[it - 1 - candidates->begin()]++;
+                }
+
+                long best_node(-1);
+                float best(-1.0f);
+                float within_cutsquare(-1.0f);
+                size_t within(0);
+                for (size_t idx = 0; idx < candidates->size(); idx++) {
+                    const size_t node((*candidates)[idx]);
+                    const HierarchyNode &candidate = tree.nodes[node];
+                    // Only a neighbor list of more than `sim` neighbors is
+                    // considered, the candidates of a level share their cut
+                    const float cutsquare(candidate.step.cut * candidate.step.cut);
+                    if (cutsquare != within_cutsquare) {
+                        within = std::count_if(distances.begin(), distances.end(),
+                                               [cutsquare](const float dist) { return dist <= cutsquare; });
+                        within_cutsquare = cutsquare;
+                    }
+                    if (within < candidate.step.sim + 1) { continue; }
+                    if (!similarities[node].mapping(shared[idx])) { continue; }
+                    const float score(static_cast<float>(shared[idx]) / static_cast<float>(candidate.size()));
+                    if (score > best) {
+                        best = score;
+                        best_node = static_cast<long>(node);
+                    }
+                }
+                if (best_node < 0) { break; }
+                const HierarchyNode &branch = tree.nodes[best_node];
+                if (branch.leaf()) {
+                    mapped[frame] = static_cast<long>(leaf_of[best_node]);
+                    break;
+                }
+                // The cut only shrinks, thus, only the neighbors within the
+                // branch and its cut count on the next level
+                const float cutsquare(branch.step.cut * branch.step.cut);
+                nearby.erase(std::remove_if(nearby.begin(), nearby.end(),
+                                            [&branch, cutsquare](const std::pair<size_t, float> &neighbor) {
+                                                return neighbor.first < branch.begin || neighbor.first >= branch.end ||
+                                                       neighbor.second > cutsquare;
+                                            }), nearby.end());
+                distances.erase(std::remove_if(distances.begin(), distances.end(),
+                                               [cutsquare](const float dist) { return dist > cutsquare; }),
+                                distances.end());
+                children.resize(branch.num_children);
+                std::iota(children.begin(), children.end(), branch.first_child);
+                candidates = &children;
+            }
+        });
+
+        // The clusters of the leaves in the frames of the full data
+        vector<vector<unsigned int> > clusters(tree.leaf_clusters(leaves));
+        for (auto &cluster : clusters)
+            for (auto &point : cluster)
+                point = frames[point];
+        for (size_t frame = 0; frame < full_data.size(); ++frame)
+            if (mapped[frame] >= 0)
+                clusters[mapped[frame]].push_back(frame);
+
+        return clusters;
+    }
+
+    // The built-in similarity policies are instantiated in clustering.cpp
+    extern template vector<vector<unsigned int> >
+    clustering<CommonNearestNeighbor::Similarity>(vector<vector<float> > &data,
+                                                  const float cut,
+                                                  const unsigned int sim,
+                                                  const int Nkeep,
+                                                  const bool mutual,
+                                                  const bool deterministic);
+
+    extern template vector<vector<unsigned int> >
+    clustering<CommonDensity::Similarity>(vector<vector<float> > &data,
+                                          const float cut,
+                                          const unsigned int sim,
+                                          const int Nkeep,
+                                          const bool mutual,
+                                          const bool deterministic);
+
+    extern template vector<vector<vector<unsigned int> > >
+    sweep<CommonNearestNeighbor::Similarity>(vector<vector<float> > &data,
+                                             const float cut,
+                                             const vector<unsigned int> &sims,
+                                             const int Nkeep);
+
+    extern template vector<vector<vector<unsigned int> > >
+    sweep<CommonDensity::Similarity>(vector<vector<float> > &data,
+                                     const float cut,
+                                     const vector<unsigned int> &sims,
+                                     const int Nkeep);
+
+    extern template void
+    hierarchical_clustering<CommonNearestNeighbor::Similarity>(Hierarchy &tree,
+                                                               vector<vector<float> > &data,
+                                                               const float delta_fe,
+                                                               const unsigned int ndims,
+                                                               const unsigned int Nkeep,
+                                                               const unsigned int Nsplit,
+                                                               const bool mutual,
+                                                               const bool deterministic,
+                                                               const string &treefile,
+                                                               const bool resume);
+
+    extern template void
+    hierarchical_clustering<CommonDensity::Similarity>(Hierarchy &tree,
+                                                       vector<vector<float> > &data,
+                                                       const float delta_fe,
+                                                       const unsigned int ndims,
+                                                       const unsigned int Nkeep,
+                                                       const unsigned int Nsplit,
+                                                       const bool mutual,
+                                                       const bool deterministic,
+                                                       const string &treefile,
+                                                       const bool resume);
+
+    extern template void
+    fast_hierarchical_clustering<CommonNearestNeighbor::Similarity>(Hierarchy &tree,
+                                                                    vector<vector<float> > &data,
+                                                                    const float delta_fe,
+                                                                    const unsigned int ndims,
+                                                                    const unsigned int Nkeep,
+                                                                    const unsigned int Nsplit,
+                                                                    const bool mutual,
+                                                                    const string &treefile,
+                                                                    const bool resume);
+
+    extern template void
+    fast_hierarchical_clustering<CommonDensity::Similarity>(Hierarchy &tree,
+                                                            vector<vector<float> > &data,
+                                                            const float delta_fe,
+                                                            const unsigned int ndims,
+                                                            const unsigned int Nkeep,
+                                                            const unsigned int Nsplit,
+                                                            const bool mutual,
+                                                            const string &treefile,
+                                                            const bool resume);
+
+    extern template vector<clstep>
+    hierarchical_clustering<CommonNearestNeighbor::Similarity>(vector<vector<unsigned int> > &clusters,
+                                                               vector<vector<float> > &data,
+                                                               const clstep init_step,
+                                                               const float delta_fe,
+                                                               const unsigned int ndims,
+                                                               const unsigned int Nkeep,
+                                                               const unsigned int Nsplit,
+                                                               const bool mutual,
+                                                               const bool deterministic);
+
+    extern template vector<clstep>
+    hierarchical_clustering<CommonDensity::Similarity>(vector<vector<unsigned int> > &clusters,
+                                                       vector<vector<float> > &data,
+                                                       const clstep init_step,
+                                                       const float delta_fe,
+                                                       const unsigned int ndims,
+                                                       const unsigned int Nkeep,
+                                                       const unsigned int Nsplit,
+                                                       const bool mutual,
+                                                       const bool deterministic);
+
+    extern template vector<vector<unsigned int> >
+    incremental_clustering<CommonNearestNeighbor::Similarity>(vector<unsigned int> &components,
+                                                              vector<vector<float> > &data,
+                                                              const float cut,
+                                                              const unsigned int sim,
+                                                              const int Nkeep);
+
+    extern template vector<vector<unsigned int> >
+    incremental_clustering<CommonDensity::Similarity>(vector<unsigned int> &components,
+                                                      vector<vector<float> > &data,
+                                                      const float cut,
+                                                      const unsigned int sim,
+                                                      const int Nkeep);
+
+    extern template class StreamClustering<CommonNearestNeighbor::Similarity>;
+
+    extern template class StreamClustering<CommonDensity::Similarity>;
+
+    extern template class Assigner<CommonNearestNeighbor::Similarity>;
+
+    extern template class Assigner<CommonDensity::Similarity>;
+
+    extern template vector<vector<unsigned int> >
+    cluster_mapping<CommonNearestNeighbor::Similarity>(vector<vector<unsigned int> > &clusters,
+                                                       vector<vector<float> > &full_data,
+                                                       vector<vector<float> > &reduced_data,
+                                                       map<unsigned int, unsigned int> &frames,
+                                                       vector<clstep> &leaves);
+
+    extern template vector<vector<unsigned int> >
+    cluster_mapping<CommonDensity::Similarity>(vector<vector<unsigned int> > &clusters,
+                                               vector<vector<float> > &full_data,
+                                               vector<vector<float> > &reduced_data,
+                                               map<unsigned int, unsigned int> &frames,
+                                               vector<clstep> &leaves);
+
+
+    extern template vector<vector<unsigned int> >
+    hierarchy_mapping<CommonNearestNeighbor::Similarity>(const Hierarchy &tree,
+                                                         vector<vector<float> > &full_data,
+                                                         vector<vector<float> > &reduced_data,
+                                                         map<unsigned int, unsigned int> &frames,
+                                                         vector<clstep> &leaves);
+
+    extern template vector<vector<unsigned int> >
+    hierarchy_mapping<CommonDensity::Similarity>(const Hierarchy &tree,
+                                                 vector<vector<float> > &full_data,
+                                                 vector<vector<float> > &reduced_data,
+                                                 map<unsigned int, unsigned int> &frames,
+                                                 vector<clstep> &leaves);
+
+}
+
+#endif //CNN_CLUSTERING_IMPL_H
@@ -23,8 +23,6 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE
 */
 
-#include "core.h"
-
 #include "cnn.h"
 
 namespace Clustering {
@@ -37,11 +35,7 @@ namespace Clustering {
                         const unsigned int point,
                         const float cut,
                         const unsigned int sim) {
-            vector<unsigned int> shared_neighbors;
-            Clustering::Core::intersection(shared_neighbors,
-                                           neighbors_ij.at(refpoint),
-                                           neighbors_ij.at(point));
-            return (shared_neighbors.size() >= sim);
+            return Similarity(data, cut, sim)(neighbors_ij, refpoint, point);
         }
 
     } // end of namespace CommonNearestNeighbor
@@ -29,6 +29,7 @@ SOFTWARE
 #include <vector>
 
 #include "neighbors.h"
+#include "core.h"      // Clustering::Core::intersection
 
 using namespace std;
 
@@ -36,6 +37,56 @@ namespace Clustering {
 
     namespace CommonNearestNeighbor {
 
+        // SIMILARITY POLICY
+        // Two points are similar if they share at least `sim`
+        // neighbors. The policy is a template argument of the
+        // clustering core such that the call can be inlined.
+        class Similarity {
+        public:
+            Similarity(const vector<vector<float> > &,
+                       const float,
+                       const unsigned int sim) : sim_(sim) {}
+
+            // The threshold is `sim` at any distance
+            static constexpr bool distance_dependent = false;
+
+            bool operator()(const Neighbors &neighbors_ij,
+                            const unsigned int refpoint,
+                            const unsigned int point) const {
+                return (Clustering::Core::count_shared(neighbors_ij.at(refpoint),
+                                                       neighbors_ij.at(point),
+                                                       sim_) >= sim_);
+            }
+
+            // Decision for an already known number of shared neighbors
+            bool operator()(const size_t shared,
+                            const unsigned int,
+                            const unsigned int) const {
+                return (shared >= sim_);
+            }
+
+            // Number of shared neighbors at which two points are similar
+            unsigned int threshold(const float) const {
+                return sim_;
+            }
+
+            // Quantity that is compared to `sim`, i.e., the shared neighbors
+            double score(const size_t shared,
+                         const unsigned int,
+                         const unsigned int) const {
+                return static_cast<double>(shared);
+            }
+
+            // Criterion of a frame being mapped onto a cluster
+            // given the number of its neighbors in the cluster.
+            bool mapping(const size_t shared) const {
+                return (shared >= sim_);
+            }
+
+        private:
+            const unsigned int sim_;
+        };
+
         ////////////// CORE UTILITY ///////////////
         bool similarity(vector<vector<float> > &data,
                         const Neighbors &neighbors_ij,
@@ -25,11 +25,15 @@ SOFTWARE
 
 #include <set>
 #include <numeric>
+#include <limits>
+#include <atomic>
 
 #include <omp.h>
 #include <parallel/algorithm>
 
 #include "tools/utility.h"
+#include "cnn.h"
+#include "vs_cnn.h"
 
 #include "core.h"
 
@@ -41,233 +45,256 @@ namespace Clustering {
         void intersection(vector<unsigned int> &out,
                           const vector<unsigned> &list1,
                           const vector<unsigned> &list2) {
+            // Always called from within parallel work, thus, sequential
             __gnu_parallel::set_intersection(list1.begin(), list1.end(),
                                              list2.begin(), list2.end(),
-                                             std::back_inserter(out));
+                                             std::back_inserter(out),
+                                             __gnu_parallel::sequential_tag());
         }
 
-        ////////////// CORE UTILITY ///////////////
-        void
-        similarity_unclustered(Similarity similarity,
-                               vector<vector<float> > &data,
-                               map<unsigned int, int> &clustered,
-                               vector<vector<unsigned int> > &clusters,
-                               const Neighbors &neighbors_ij,
-                               const vector<unsigned int> &input,
-                               const unsigned int refpoint,
-                               const float cut,
-                               const unsigned int sim) {
-            vector<unsigned int> cluster(1, refpoint);
-            unsigned int cluster_idx(clusters.size());
-
-            unsigned int refpoint_is_clustered = 0;
-#pragma omp critical
-            refpoint_is_clustered = clustered.count(refpoint);
-
-            if (refpoint_is_clustered == 0) {
-#ifdef _OPENMP
-#pragma omp parallel for default(none) shared(similarity, data, clustered, cluster, neighbors_ij, input, cluster_idx)
-#endif
-                for (size_t i = 0; i < input.size(); i++) {
-                    const unsigned int point = input.at(i);
-                    if (clustered.count(point) == 0) {
-                        if (point != refpoint && neighbors_ij.count(point) == 1) {
-                            bool similar = similarity(data,
-                                                      neighbors_ij,
-                                                      refpoint,
-                                                      point,
-                                                      cut,
-                                                      sim);
-#pragma omp critical
-                            if (similar) {
-                                clustered[point] = cluster_idx;
-                                cluster.push_back(point);
-                            }
-                        }
-                    }
+        size_t count_shared(const vector<unsigned int> &list1,
+                            const vector<unsigned int> &list2,
+                            const size_t needed) {
+            size_t shared(0);
+            auto it1 = list1.begin(), it2 = list2.begin();
+            while (it1 != list1.end() && it2 != list2.end() && shared < needed) {
+                // Stop as soon as the rest of a list cannot reach `needed`
+                const size_t missing(needed - shared);
+                if (static_cast<size_t>(list1.end() - it1) < missing ||
+                    static_cast<size_t>(list2.end() - it2) < missing)
+                    break;
+                if (*it1 < *it2) {
+                    ++it1;
+                } else if (*it2 < *it1) {
+                    ++it2;
+                } else {
+                    ++shared;
+                    ++it1;
+                    ++it2;
                 }
-                // Only add this cluster if at least two points was added
-                if (cluster.size() > 1) {
-                    clustered[refpoint] = cluster_idx;
-                    clusters.push_back(cluster);
-                }
-            } else {
-                cout << "intersect_unclustered:" << endl;
-                cout << "If you read this message please report." << endl;
-                cout << refpoint << " " << refpoint_is_clustered << endl;
             }
+            return shared;
         }
 
-        void similarity_clustered(Similarity similarity,
-                                  vector<vector<float> > &data,
-                                  map<unsigned int, int> &clustered,
-                                  vector<vector<unsigned int> > &clusters,
-                                  const Neighbors &neighbors_ij,
-                                  const vector<unsigned int> &input,
-                                  const unsigned int refpoint,
-                                  const float cut,
-                                  const unsigned int sim) {
-            unsigned int cluster_idx = clustered[refpoint];
-
-            unsigned int refpoint_is_clustered = 1;
-#pragma omp critical
-            refpoint_is_clustered = clustered.count(refpoint);
-
-            if (clustered.count(refpoint) == 1) {
-                for (auto const &point : input) {
-                    if (clustered.count(point) == 0) {
-                        if (point != refpoint && neighbors_ij.count(point) == 1) {
-                            bool similar = similarity(data,
-                                                      neighbors_ij,
-                                                      refpoint,
-                                                      point,
-                                                      cut,
-                                                      sim);
-#pragma omp critical
-                            if (clustered.count(point) == 0) {
-                                if (similar) {
-                                    clusters[cluster_idx].push_back(point);
-                                    clustered[point] = cluster_idx;
-                                }
-                            }
-                        }
-                    }
+        bool shared_neighbor_counts(vector<unsigned int> &counts,
+                                    const Neighbors &neighbors_ij,
+                                    const unsigned int refpoint,
+                                    const vector<unsigned int> &points) {
+            // Gather the rows first such that no counter is touched if a list is missing
+            const vector<unsigned int> &neighbors_i = neighbors_ij.at(refpoint);
+            vector<const vector<unsigned int> *> rows;
+            rows.reserve(neighbors_i.size());
+            for (auto const &neighbor : neighbors_i) {
+                auto row = neighbors_ij.find(neighbor);
+                if (row == neighbors_ij.end()) { return false; }
+                rows.push_back(&(row->second));
+            }
+
+            // Dense counter of this thread that is all zero between calls
+            static thread_local vector<unsigned int> counter;
+            static thread_local vector<unsigned int> touched;
+            for (auto const &row : rows) {
+                if (!row->empty() && row->back() >= counter.size())
+                    counter.resize(row->back() + 1, 0);
+                for (auto const &point : *row) {
+                    if (counter[point] == 0) { touched.push_back(point); }
+                    ++counter[point];
                 }
-            } else {
-                cout << "intersect_clustered:" << endl;
-                cout << "If you read this message please report." << endl;
-                cout << refpoint << " " << refpoint_is_clustered << endl;
             }
+
+            counts.resize(points.size());
+            for (size_t i = 0; i < points.size(); i++)
+                counts[i] = (points[i] < counter.size()) ? counter[points[i]] : 0;
+
+            for (auto const &point : touched)
+                counter[point] = 0;
+            touched.clear();
+            return true;
         }
 
-        // USER INTERFACE CLUSTERING
-        // Clusters the data
-        vector<vector<unsigned int> >
-        algorithm(Similarity similarity,
-                  vector<vector<float> > &data,
-                  Neighbors &neighbors_ij,
-                  Neighbors &second_neighbors_ij,
-                  const float cut,
-                  const unsigned int sim,
-                  const unsigned int Nkeep,
-                  const bool mutual) {
-            map<unsigned int, int> clustered;
-            vector<vector<unsigned int> > clusters;
-
-            // sort by size of neighbor lists
-            vector<std::pair<unsigned int, unsigned int> > neighbor_list_sizes;
-            for (auto const &list : neighbors_ij) {
-                const unsigned int refpoint = list.first;
-                unsigned int neighbor_list_size = neighbors_ij[refpoint].size();
-                if (!mutual && second_neighbors_ij.count(refpoint) == 1) {
-                    neighbor_list_size += second_neighbors_ij.size();
-                }
-                neighbor_list_sizes.emplace_back(refpoint, neighbor_list_size);
+        bool use_bulk_evaluation(const size_t num_candidates,
+                                 const size_t num_neighbors) {
+            // Pairwise merges cost about `num_candidates` times the list
+            // length, while the scatter streams once over the lists of
+            // all `num_neighbors` neighbors. Hence, the bulk evaluation
+            // pays off once a sizeable part of the list is a candidate.
+            const size_t min_candidates = 16;
+            return (num_candidates >= min_candidates && 2 * num_candidates >= num_neighbors);
+        }
+
+        void shared_neighbor_cuts(vector<std::pair<unsigned int, unsigned int> > &pairs,
+                                  vector<float> &shared_cuts,
+                                  const Graph &graph,
+                                  const vector<char> &members,
+                                  const unsigned int depth) {
+            auto member = [&members](const unsigned int point) {
+                return point < members.size() && members[point] != 0;
+            };
+
+            // Each undirected edge is evaluated from its lower point
+            vector<size_t> first_pair(graph.num_points() + 1, 0);
+            for (unsigned int point = 0; point < graph.num_points(); point++) {
+                if (!member(point)) { continue; }
+                for (size_t edge = graph.offsets[point]; edge < graph.offsets[point + 1]; edge++)
+                    if (graph.edges[edge] > point && member(graph.edges[edge]))
+                        first_pair[point + 1]++;
             }
-            // TODO : sorting can actually be removed. But for the sake of debugging we keep it right now.
-            sort(neighbor_list_sizes.begin(), neighbor_list_sizes.end(),
-                 [](const std::pair<unsigned int, unsigned int> &a,
-                    const std::pair<unsigned int, unsigned int> &b) {
-                     return a.second > b.second;
-                 });
-
-            // Goes through all points/frames/keys with neighbor lists
-            unsigned prev_nof_clusters = clusters.size();
-            for (auto const &it : neighbor_list_sizes) {
-                const unsigned int refpoint = it.first;
-
-                // Try seeding new cluster on current `refpoint`
-                // exploiting its neighbor list and its second neighbor
-                // list given `mutual` is turned off.
-                if (clustered.count(refpoint) == 0) {
-                    similarity_unclustered(similarity,
-                                           data,
-                                           clustered,
-                                           clusters,
-                                           neighbors_ij,
-                                           neighbors_ij[refpoint],
-                                           refpoint, cut,
-                                           sim);
-                    if (!mutual) {
-                        if (clustered.count(refpoint) == 0) {
-                            similarity_unclustered(similarity,
-                                                   data,
-                                                   clustered,
-                                                   clusters,
-                                                   neighbors_ij,
-                                                   second_neighbors_ij[refpoint],
-                                                   refpoint,
-                                                   cut,
-                                                   sim);
-                        } else if (clustered.count(refpoint) == 1) {
-                            similarity_clustered(similarity,
-                                                 data,
-                                                 clustered,
-                                                 clusters,
-                                                 neighbors_ij,
-                                                 second_neighbors_ij[refpoint],
-                                                 refpoint, cut,
-                                                 sim);
-                        }
-                    }
+            std::partial_sum(first_pair.begin(), first_pair.end(), first_pair.begin());
 
-                    // Go to next neighbor list if the current `refpoint` did not generate a new cluster.
-                    if (clusters.size() > prev_nof_clusters) {
-                        prev_nof_clusters = clusters.size();
-                        const unsigned int cluster_idx = prev_nof_clusters - 1;
-
-                        // Try adding points until no new points are added to the cluster
-                        vector<unsigned int> to_consider(clusters[cluster_idx]);
-                        __gnu_parallel::sort(to_consider.begin(), to_consider.end());
-                        while (to_consider.size() > 0) {
-                            vector<unsigned int> prev_cluster(clusters[cluster_idx]);
-                            __gnu_parallel::sort(prev_cluster.begin(), prev_cluster.end());
-#ifdef _OPENMP
-#pragma omp parallel for default(none) shared(similarity, data, clustered, clusters, neighbors_ij, second_neighbors_ij, to_consider)
-#endif
-                            for (unsigned int frame = 0; frame < to_consider.size(); frame++) {
-                                const unsigned int clpoint = to_consider[frame];
-                                if (neighbors_ij.count(clpoint) == 1) {
-                                    similarity_clustered(similarity,
-                                                         data,
-                                                         clustered,
-                                                         clusters,
-                                                         neighbors_ij,
-                                                         neighbors_ij[clpoint],
-                                                         clpoint,
-                                                         cut,
-                                                         sim);
-                                }
-                                if (!mutual && second_neighbors_ij.count(clpoint) == 1) {
-                                    similarity_clustered(similarity,
-                                                         data,
-                                                         clustered,
-                                                         clusters,
-                                                         neighbors_ij,
-                                                         second_neighbors_ij[clpoint],
-                                                         clpoint,
-                                                         cut,
-                                                         sim);
-                                }
-                            }
-                            vector<unsigned int> current_cluster(clusters[cluster_idx]);
-                            __gnu_parallel::sort(current_cluster.begin(), current_cluster.end());
-
-                            to_consider.clear();
-                            __gnu_parallel::set_difference(current_cluster.begin(),
-                                                           current_cluster.end(),
-                                                           prev_cluster.begin(),
-                                                           prev_cluster.end(),
-                                                           std::back_inserter(to_consider));
-                        }
-                    }
-                }
+            // Rows by increasing distance, such that the scan of a row stops
+            // once its distances cannot improve the kept cuts anymore
+            vector<std::pair<float, unsigned int> > nearest_first(graph.edges.size());
+            Clustering::Utility::parallel_tasks(graph.num_points(), 16, [&](const size_t point) {
+                if (!member(point)) { return; }
+                for (size_t edge = graph.offsets[point]; edge < graph.offsets[point + 1]; edge++)
+                    nearest_first[edge] = std::make_pair(graph.distances[edge], graph.edges[edge]);
+                __gnu_parallel::sort(nearest_first.begin() + graph.offsets[point],
+                                     nearest_first.begin() + graph.offsets[point + 1],
+                                     __gnu_parallel::sequential_tag());
+            });
+
+            pairs.resize(first_pair.back());
+            shared_cuts.assign(first_pair.back() * depth, std::numeric_limits<float>::infinity());
+            if (depth == 0) {
+                size_t pair(0);
+                for (unsigned int point = 0; point < graph.num_points(); point++)
+                    for (size_t edge = graph.offsets[point]; edge < graph.offsets[point + 1]; edge++)
+                        if (member(point) && graph.edges[edge] > point && member(graph.edges[edge]))
+                            pairs[pair++] = std::make_pair(point, graph.edges[edge]);
+                return;
             }
+            Clustering::Utility::parallel_tasks(graph.num_points(), 16, [&](const size_t point) {
+                if (!member(point)) { return; }
 
-            Clustering::Utility::sortNclean(clusters, Nkeep);
+                // Dense row of this thread that is all infinity between points
+                static thread_local vector<float> row;
+                if (row.size() < graph.num_points())
+                    row.resize(graph.num_points(), std::numeric_limits<float>::infinity());
+                for (size_t edge = graph.offsets[point]; edge < graph.offsets[point + 1]; edge++)
+                    row[graph.edges[edge]] = graph.distances[edge];
 
-            return clusters;
+                size_t pair(first_pair[point]);
+                for (size_t edge = graph.offsets[point]; edge < graph.offsets[point + 1]; edge++) {
+                    const unsigned int neighbor = graph.edges[edge];
+                    if (neighbor <= point || !member(neighbor)) { continue; }
+                    pairs[pair] = std::make_pair(static_cast<unsigned int>(point), neighbor);
+
+                    // A shared neighbor counts once the cut reaches its larger
+                    // distance, only the `depth` smallest ones are kept sorted
+                    float *cuts = shared_cuts.data() + pair * depth;
+                    for (size_t other = graph.offsets[neighbor]; other < graph.offsets[neighbor + 1]; other++) {
+                        if (!(nearest_first[other].first < cuts[depth - 1])) { break; }
+                        const float cut = std::max(row[nearest_first[other].second], nearest_first[other].first);
+                        if (!(cut < cuts[depth - 1])) { continue; }
+                        size_t position(depth - 1);
+                        for (; position > 0 && cuts[position - 1] > cut; position--)
+                            cuts[position] = cuts[position - 1];
+                        cuts[position] = cut;
+                    }
+                    pair++;
+                }
+
+                for (size_t edge = graph.offsets[point]; edge < graph.offsets[point + 1]; edge++)
+                    row[graph.edges[edge]] = std::numeric_limits<float>::infinity();
+            });
         }
 
+        // Explicit instantiations for the built-in similarity policies
+        template void similarity_unclustered<CommonNearestNeighbor::Similarity>(
+                const CommonNearestNeighbor::Similarity &similarity,
+                map<unsigned int, int> &clustered,
+                vector<vector<unsigned int> > &clusters,
+                const Neighbors &neighbors_ij,
+                const vector<unsigned int> &input,
+                const unsigned int refpoint);
+
+        template void similarity_unclustered<CommonDensity::Similarity>(
+                const CommonDensity::Similarity &similarity,
+                map<unsigned int, int> &clustered,
+                vector<vector<unsigned int> > &clusters,
+                const Neighbors &neighbors_ij,
+                const vector<unsigned int> &input,
+                const unsigned int refpoint);
+
+        template void similarity_clustered<CommonNearestNeighbor::Similarity>(
+                const CommonNearestNeighbor::Similarity &similarity,
+                map<unsigned int, int> &clustered,
+                vector<vector<unsigned int> > &clusters,
+                const Neighbors &neighbors_ij,
+                const vector<unsigned int> &input,
+                const unsigned int refpoint);
+
+        template void similarity_clustered<CommonDensity::Similarity>(
+                const CommonDensity::Similarity &similarity,
+                map<unsigned int, int> &clustered,
+                vector<vector<unsigned int> > &clusters,
+                const Neighbors &neighbors_ij,
+                const vector<unsigned int> &input,
+                const unsigned int refpoint);
+
+        template vector<unsigned int> similarity_frontier<CommonNearestNeighbor::Similarity>(
+                const CommonNearestNeighbor::Similarity &similarity,
+                map<unsigned int, int> &clustered,
+                vector<unsigned int> &cluster,
+                const int cluster_idx,
+                const Neighbors &neighbors_ij,
+                const Graph &graph,
+                const vector<unsigned int> &frontier);
+
+        template vector<unsigned int> similarity_frontier<CommonDensity::Similarity>(
+                const CommonDensity::Similarity &similarity,
+                map<unsigned int, int> &clustered,
+                vector<unsigned int> &cluster,
+                const int cluster_idx,
+                const Neighbors &neighbors_ij,
+                const Graph &graph,
+                const vector<unsigned int> &frontier);
+
+        template vector<vector<unsigned int> > speculative_clusters<CommonNearestNeighbor::Similarity>(
+                const CommonNearestNeighbor::Similarity &similarity,
+                const Neighbors &neighbors_ij,
+                const Graph &graph,
+                const vector<unsigned int> &seeds);
+
+        template vector<vector<unsigned int> > speculative_clusters<CommonDensity::Similarity>(
+                const CommonDensity::Similarity &similarity,
+                const Neighbors &neighbors_ij,
+                const Graph &graph,
+                const vector<unsigned int> &seeds);
+
+        template vector<vector<unsigned int> >
+        algorithm<CommonNearestNeighbor::Similarity>(vector<vector<float> > &data,
+                                                     Neighbors &neighbors_ij,
+                                                     Neighbors &second_neighbors_ij,
+                                                     const float cut,
+                                                     const unsigned int sim,
+                                                     const unsigned int Nkeep,
+                                                     const bool mutual,
+                                                     const bool deterministic);
+
+        template vector<vector<unsigned int> >
+        algorithm<CommonDensity::Similarity>(vector<vector<float> > &data,
+                                             Neighbors &neighbors_ij,
+                                             Neighbors &second_neighbors_ij,
+                                             const float cut,
+                                             const unsigned int sim,
+                                             const unsigned int Nkeep,
+                                             const bool mutual,
+                                             const bool deterministic);
+
+        template vector<vector<vector<unsigned int> > >
+        sweep<CommonNearestNeighbor::Similarity>(vector<vector<float> > &data,
+                                                 Neighbors &neighbors_ij,
+                                                 const float cut,
+                                                 const vector<unsigned int> &sims,
+                                                 const unsigned int Nkeep);
+
+        template vector<vector<vector<unsigned int> > >
+        sweep<CommonDensity::Similarity>(vector<vector<float> > &data,
+                                         Neighbors &neighbors_ij,
+                                         const float cut,
+                                         const vector<unsigned int> &sims,
+                                         const unsigned int Nkeep);
+
     } // end of namespace CommonNearestNeighbor
 } // endo of namespace Clustering
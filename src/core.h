@@ -30,6 +30,7 @@ SOFTWARE
 
 #include <cstdlib>
 #include <cmath>
+#include <cstdint>
 #include <vector>
 #include <utility>
 
@@ -42,19 +43,19 @@ namespace Clustering {
 
     namespace Core {
 
-        typedef bool Similarity(vector<vector<float> > &data,
-                                const Neighbors &neighbors_ij,
-                                const unsigned int refpoint,
-                                const unsigned int point,
-                                const float cut,
-                                const unsigned int sim);
-
-        typedef bool (*simptr)(vector<vector<float> > &data,
-                               const Neighbors &neighbors_ij,
-                               const unsigned int refpoint,
-                               const unsigned int point,
-                               const float cut,
-                               const unsigned int sim);
+        // The clustering core is templated on a similarity policy
+        // `Similarity` which is constructed from the data, the cut
+        // and the similarity parameter of a clustering run and
+        // which decides via `similarity(neighbors_ij, refpoint, point)`
+        // or, given the number of shared neighbors, via
+        // `similarity(shared, refpoint, point)` whether two points are
+        // similar. Since the decision only depends on the distance of
+        // the points, `threshold(distance)` gives the number of shared
+        // neighbors at which two points become similar and
+        // `distance_dependent` whether the edges of the graph are
+        // annotated with distances for it. The definitions live in
+        // core_impl.h, the policies of CNN and vs-CNN are explicitly
+        // instantiated in core.cpp.
 
         ////////////// CORE UTILITY ///////////////
         // Wrapper for the STL intersection algorithm
@@ -62,6 +63,139 @@ namespace Clustering {
                           const vector<unsigned> &list1,
                           const vector<unsigned> &list2);
 
+        // Number of shared elements of two sorted lists which is only
+        // counted until it reaches `needed` or can no longer reach it.
+        size_t count_shared(const vector<unsigned int> &list1,
+                            const vector<unsigned int> &list2,
+                            const size_t needed);
+
+        ////////////// CORE UTILITY ///////////////
+        // Bulk evaluation of the number of shared neighbors of
+        // `refpoint` with each of `points` as in a sparse A*A row
+        // product: the neighbor lists of all neighbors of `refpoint`
+        // are scattered into a dense per-thread counter. This requires
+        // symmetric neighbor lists and returns false without
+        // computing `counts` if a neighbor of `refpoint` has no list.
+        bool shared_neighbor_counts(vector<unsigned int> &counts,
+                                    const Neighbors &neighbors_ij,
+                                    const unsigned int refpoint,
+                                    const vector<unsigned int> &points);
+
+        // Decides whether `num_candidates` points of a neighbor list of
+        // length `num_neighbors` are evaluated in bulk or pairwise.
+        bool use_bulk_evaluation(const size_t num_candidates,
+                                 const size_t num_neighbors);
+
+        ////////////// CORE UTILITY ///////////////
+        // For every undirected edge of a hierarchy level graph, see
+        // nns::cluster_graph, between two of the `members`, the `depth`
+        // smallest squared cuts at which a shared neighbor is within
+        // the cut of both points, in ascending order and padded with
+        // infinity. Since the lists only shrink with the cut, the number
+        // of shared neighbors at any smaller cut follows without
+        // intersecting the lists again. The edges are given in `pairs`.
+        void shared_neighbor_cuts(vector<std::pair<unsigned int, unsigned int> > &pairs,
+                                  vector<float> &shared_cuts,
+                                  const Graph &graph,
+                                  const vector<char> &members,
+                                  const unsigned int depth);
+
+        ////////////// CORE UTILITY ///////////////
+        // Two-bit states of the similarity edges aligned with the
+        // edges of a Graph. Since a state only changes once from
+        // `unknown` to either `similar` or `dissimilar`, concurrent
+        // updates are atomic bitwise ors on the packed words.
+        class EdgeStates {
+        public:
+            enum State { unknown = 0, similar = 1, dissimilar = 2 };
+
+            explicit EdgeStates(const size_t num_edges) : words_((num_edges + 15) / 16, 0) {}
+
+            State get(const size_t edge) const {
+                uint32_t word;
+#pragma omp atomic read
+                word = words_[edge / 16];
+                return static_cast<State>((word >> (2 * (edge % 16))) & 3u);
+            }
+
+            void set(const size_t edge, const State state) {
+                const uint32_t bits = static_cast<uint32_t>(state) << (2 * (edge % 16));
+#pragma omp atomic update
+                words_[edge / 16] |= bits;
+            }
+
+        private:
+            vector<uint32_t> words_;
+        };
+
+        // Similarity policy adaptor that evaluates every undirected
+        // edge of `graph` at most once per clustering run. The result
+        // is stored for the edge and its mirrored edge such that
+        // neither expansion waves nor failed seeds intersect a pair
+        // twice. Pairs that are not edges of `graph`, e.g., second
+        // neighbors, are passed through to the policy. If the edges
+        // of `graph` carry distances, the policy only gives the
+        // threshold of an edge and a decision is an integer compare,
+        // i.e., an intersection that stops at the threshold.
+        template<class Similarity>
+        class CachedSimilarity {
+        public:
+            CachedSimilarity(const Similarity &similarity,
+                             const Graph &graph) :
+                    similarity_(similarity),
+                    graph_(graph),
+                    states_(graph.edges.size()) {}
+
+            bool operator()(const Neighbors &neighbors_ij,
+                            const unsigned int refpoint,
+                            const unsigned int point) const {
+                return cached(refpoint, point, [&](const size_t edge) {
+                    if (graph_.distances.empty() || edge == graph_.edges.size())
+                        return similarity_(neighbors_ij, refpoint, point);
+                    const size_t threshold = similarity_.threshold(graph_.distances[edge]);
+                    return count_shared(neighbors_ij.at(refpoint), neighbors_ij.at(point), threshold) >= threshold;
+                });
+            }
+
+            bool operator()(const size_t shared,
+                            const unsigned int refpoint,
+                            const unsigned int point) const {
+                return cached(refpoint, point, [&](const size_t edge) {
+                    if (graph_.distances.empty() || edge == graph_.edges.size())
+                        return similarity_(shared, refpoint, point);
+                    return shared >= similarity_.threshold(graph_.distances[edge]);
+                });
+            }
+
+            bool mapping(const size_t shared) const {
+                return similarity_.mapping(shared);
+            }
+
+        private:
+            template<class Evaluate>
+            bool cached(const unsigned int refpoint,
+                        const unsigned int point,
+                        Evaluate evaluate) const {
+                const size_t edge = graph_.edge(refpoint, point);
+                if (edge == graph_.edges.size())
+                    return evaluate(edge);
+
+                EdgeStates::State state = states_.get(edge);
+                if (state == EdgeStates::unknown) {
+                    state = evaluate(edge) ? EdgeStates::similar : EdgeStates::dissimilar;
+                    states_.set(edge, state);
+                    const size_t mirror = graph_.edge(point, refpoint);
+                    if (mirror != graph_.edges.size())
+                        states_.set(mirror, state);
+                }
+                return (state == EdgeStates::similar);
+            }
+
+            const Similarity &similarity_;
+            const Graph &graph_;
+            mutable EdgeStates states_;
+        };
+
         ////////////// CORE UTILITY ///////////////
         // CLUSTERING CORE FUNCTION
         // Intersects neighbor lists from points in `input` with the
@@ -69,16 +203,14 @@ namespace Clustering {
         // neighbors, i.e., their similarity. Outputs the clustered
         // points and `refpoint` into a NEW cluster in `clusters`
         // and a NEW cluster label in`clustered`.
+        template<class Similarity>
         void
-        similarity_unclustered(Similarity similarity,
-                               vector<vector<float> > &data,
+        similarity_unclustered(const Similarity &similarity,
                                map<unsigned int, int> &clustered,
                                vector<vector<unsigned int> > &clusters,
                                const Neighbors &neighbors_ij,
                                const vector<unsigned int> &input,
-                               const unsigned int refpoint,
-                               const float cut,
-                               const unsigned int sim);
+                               const unsigned int refpoint);
 
         // CLUSTERING CORE FUNCTION
         // Intersects neighbor lists from points in `input` with the
@@ -87,29 +219,88 @@ namespace Clustering {
         // points and `refpoint` into the cluster of `refpoint` in
         // `clusters` and associated cluster label of `refpoint`
         // to the newly clustered point in`clustered`.
-        void similarity_clustered(Similarity similarity,
-                                  vector<vector<float> > &data,
+        template<class Similarity>
+        void similarity_clustered(const Similarity &similarity,
                                   map<unsigned int, int> &clustered,
                                   vector<vector<unsigned int> > &clusters,
                                   const Neighbors &neighbors_ij,
                                   const vector<unsigned int> &input,
-                                  const unsigned int refpoint,
-                                  const float cut,
-                                  const unsigned int sim);
+                                  const unsigned int refpoint);
+
+        // CLUSTERING CORE FUNCTION
+        // Deterministic expansion of cluster `cluster_idx` by a whole
+        // `frontier`. The similar, unclustered candidates of all frontier
+        // points are evaluated in parallel while `clustered` is only read,
+        // and they are merged afterwards in the order of the frontier.
+        // Candidates are the neighbors of a point in `graph`, i.e., of both
+        // shells if not mutual. Returns the newly clustered points, i.e.,
+        // the next frontier, in ascending order.
+        template<class Similarity>
+        vector<unsigned int>
+        similarity_frontier(const Similarity &similarity,
+                            map<unsigned int, int> &clustered,
+                            vector<unsigned int> &cluster,
+                            const int cluster_idx,
+                            const Neighbors &neighbors_ij,
+                            const Graph &graph,
+                            const vector<unsigned int> &frontier);
+
+        // CLUSTERING CORE FUNCTION
+        // Speculative parallel seeding. Regions grow concurrently from the
+        // `seeds` in their order, a point belongs to the region that
+        // claims it first, and regions touching via a similar edge are
+        // merged afterwards. This gives the clusters of the sequential
+        // definition, i.e., the connected components of similar edges,
+        // ordered by their first seed and with ascending members.
+        // Regions grow along the edges of `graph`.
+        template<class Similarity>
+        vector<vector<unsigned int> >
+        speculative_clusters(const Similarity &similarity,
+                             const Neighbors &neighbors_ij,
+                             const Graph &graph,
+                             const vector<unsigned int> &seeds);
 
         // USER INTERFACE CLUSTERING
-        // Clusters the data
+        // Clusters the data. The `deterministic` mode gives identical
+        // clusters, members and order for any number of threads.
+        template<class Similarity>
         vector<vector<unsigned int> >
-        algorithm(Similarity similarity,
-                  vector<vector<float> > &data,
+        algorithm(vector<vector<float> > &data,
                   Neighbors &neighbor_ij,
                   Neighbors &second_neighbor_ij,
                   const float cut,
                   const unsigned int sim,
                   const unsigned int Nkeep,
-                  const bool mutual);
+                  const bool mutual,
+                  const bool deterministic = false);
+
+        // CLUSTERING CORE FUNCTION
+        // Evaluates the score of `similarity`, e.g., the number of
+        // shared neighbors, once for every undirected edge of `graph`
+        // whose points both have neighbor lists. Edges without a score
+        // are set to minus infinity.
+        template<class Similarity>
+        void edge_scores(vector<double> &scores,
+                         const Similarity &similarity,
+                         const Graph &graph,
+                         const Neighbors &neighbors_ij);
+
+        // USER INTERFACE SIMILARITY SWEEP
+        // Clusters the data for each of `sims` from one pass over the
+        // edges. With mutual neighbors the clusters of `algorithm` are
+        // the connected components of the similar edges, thus, each
+        // clustering is a threshold of the edge scores.
+        template<class Similarity>
+        vector<vector<vector<unsigned int> > >
+        sweep(vector<vector<float> > &data,
+              Neighbors &neighbor_ij,
+              const float cut,
+              const vector<unsigned int> &sims,
+              const unsigned int Nkeep);
 
     } // end namespace Core
 } // end namespace Clustering
 
+#include "core_impl.h"
+
 #endif //CLUSTERING_CORE_H
@@ -0,0 +1,658 @@
+/*
+
+MIT License
+
+Copyright (c) 2020, R. Gregor Weiß, Benjamin Ries
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE
+*/
+
+#ifndef CLUSTERING_CORE_IMPL_H
+#define CLUSTERING_CORE_IMPL_H
+
+#include <set>
+#include <numeric>
+#include <limits>
+#include <atomic>
+
+#include <omp.h>
+#include <parallel/algorithm>
+
+#include "tools/utility.h"
+
+// Template definitions of core.h, included at its end
+
+namespace Clustering {
+
+    namespace CommonNearestNeighbor {
+        class Similarity;
+    }
+
+    namespace CommonDensity {
+        class Similarity;
+    }
+
+    namespace Core {
+
+        ////////////// CORE UTILITY ///////////////
+        template<class Similarity>
+        void
+        similarity_unclustered(const Similarity &similarity,
+                               map<unsigned int, int> &clustered,
+                               vector<vector<unsigned int> > &clusters,
+                               const Neighbors &neighbors_ij,
+                               const vector<unsigned int> &input,
+                               const unsigned int refpoint) {
+            vector<unsigned int> cluster(1, refpoint);
+            unsigned int cluster_idx(clusters.size());
+
+            unsigned int refpoint_is_clustered = 0;
+#pragma omp critical
+            refpoint_is_clustered = clustered.count(refpoint);
+
+            if (refpoint_is_clustered == 0) {
+                vector<unsigned int> candidates;
+                for (auto const &point : input)
+                    if (point != refpoint && clustered.count(point) == 0 && neighbors_ij.count(point) == 1)
+                        candidates.push_back(point);
+
+                // Shared neighbors of all candidates at once if there are many
+                vector<unsigned int> counts;
+                bool bulk = use_bulk_evaluation(candidates.size(), input.size()) &&
+                                  shared_neighbor_counts(counts, neighbors_ij, refpoint, candidates);
+
+                vector<char> similar(candidates.size(), 0);
+                Clustering::Utility::parallel_tasks(candidates.size(), 64, [&](const size_t i) {
+                    const unsigned int point = candidates[i];
+                    similar[i] = bulk ? similarity(counts[i], refpoint, point)
+                                      : similarity(neighbors_ij, refpoint, point);
+                });
+                for (size_t i = 0; i < candidates.size(); i++) {
+                    if (similar[i]) {
+                        clustered[candidates[i]] = cluster_idx;
+                        cluster.push_back(candidates[i]);
+                    }
+                }
+                // Only add this cluster if at least two points was added
+                if (cluster.size() > 1) {
+                    clustered[refpoint] = cluster_idx;
+                    clusters.push_back(cluster);
+                }
+            } else {
+                cout << "intersect_unclustered:" << endl;
+                cout << "If you read this message please report." << endl;
+                cout << refpoint << " " << refpoint_is_clustered << endl;
+            }
+        }
+
+        template<class Similarity>
+        void similarity_clustered(const Similarity &similarity,
+                                  map<unsigned int, int> &clustered,
+                                  vector<vector<unsigned int> > &clusters,
+                                  const Neighbors &neighbors_ij,
+                                  const vector<unsigned int> &input,
+                                  const unsigned int refpoint) {
+            unsigned int cluster_idx = clustered[refpoint];
+
+            unsigned int refpoint_is_clustered = 1;
+#pragma omp critical
+            refpoint_is_clustered = clustered.count(refpoint);
+
+            if (clustered.count(refpoint) == 1) {
+                vector<unsigned int> candidates;
+                for (auto const &point : input)
+                    if (point != refpoint && clustered.count(point) == 0 && neighbors_ij.count(point) == 1)
+                        candidates.push_back(point);
+
+                // Shared neighbors of all candidates at once if there are many
+                vector<unsigned int> counts;
+                bool bulk = use_bulk_evaluation(candidates.size(), input.size()) &&
+                                  shared_neighbor_counts(counts, neighbors_ij, refpoint, candidates);
+
+                for (size_t i = 0; i < candidates.size(); i++) {
+                    const unsigned int point = candidates[i];
+                    // Other threads may have clustered the point in the meantime
+                    if (!bulk && clustered.count(point) == 1) { continue; }
+                    bool similar = bulk ? similarity(counts[i], refpoint, point)
+                                        : similarity(neighbors_ij, refpoint, point);
+#pragma omp critical
+                    if (clustered.count(point) == 0) {
+                        if (similar) {
+                            clusters[cluster_idx].push_back(point);
+                            clustered[point] = cluster_idx;
+                        }
+                    }
+                }
+            } else {
+                cout << "intersect_clustered:" << endl;
+                cout << "If you read this message please report." << endl;
+                cout << refpoint << " " << refpoint_is_clustered << endl;
+            }
+        }
+
+        template<class Similarity>
+        vector<unsigned int>
+        similarity_frontier(const Similarity &similarity,
+                            map<unsigned int, int> &clustered,
+                            vector<unsigned int> &cluster,
+                            const int cluster_idx,
+                            const Neighbors &neighbors_ij,
+                            const Graph &graph,
+                            const vector<unsigned int> &frontier) {
+            vector<vector<unsigned int> > similar_points(frontier.size());
+
+            Clustering::Utility::parallel_tasks(frontier.size(), 1, [&](const size_t i) {
+                const unsigned int refpoint = frontier[i];
+                if (neighbors_ij.count(refpoint) == 0) { return; }
+
+                // Candidates of both shells, shared neighbors within the cutoff only
+                vector<unsigned int> candidates;
+                for (size_t edge = graph.offsets[refpoint]; edge < graph.offsets[refpoint + 1]; edge++) {
+                    const unsigned int point = graph.edges[edge];
+                    if (clustered.count(point) == 0 && neighbors_ij.count(point) == 1)
+                        candidates.push_back(point);
+                }
+
+                vector<unsigned int> counts;
+                const bool bulk = use_bulk_evaluation(candidates.size(), graph.degree(refpoint)) &&
+                                  shared_neighbor_counts(counts, neighbors_ij, refpoint, candidates);
+
+                for (size_t j = 0; j < candidates.size(); j++) {
+                    const bool similar = bulk ? similarity(counts[j], refpoint, candidates[j])
+                                              : similarity(neighbors_ij, refpoint, candidates[j]);
+                    if (similar)
+                        similar_points[i].push_back(candidates[j]);
+                }
+            });
+
+            // The first frontier point that found a point adds it
+            vector<unsigned int> next_frontier;
+            for (auto const &points : similar_points)
+                for (auto const &point : points)
+                    if (clustered.count(point) == 0) {
+                        clustered[point] = cluster_idx;
+                        cluster.push_back(point);
+                        next_frontier.push_back(point);
+                    }
+            __gnu_parallel::sort(next_frontier.begin(), next_frontier.end());
+
+            return next_frontier;
+        }
+
+        template<class Similarity>
+        vector<vector<unsigned int> >
+        speculative_clusters(const Similarity &similarity,
+                             const Neighbors &neighbors_ij,
+                             const Graph &graph,
+                             const vector<unsigned int> &seeds) {
+            // Region of each point, i.e., the seed rank + 1, or 0 if unclaimed
+            const unsigned int num_points = graph.num_points();
+            vector<std::atomic<unsigned int> > owner(num_points);
+            for (auto &region : owner)
+                region.store(0);
+            vector<std::pair<unsigned int, unsigned int> > touching;
+
+            Clustering::Utility::parallel_tasks(seeds.size(), 1, [&](const size_t rank) {
+                const unsigned int region = rank + 1;
+                unsigned int claimed = 0;
+                if (!owner[seeds[rank]].compare_exchange_strong(claimed, region)) { return; }
+
+                vector<std::pair<unsigned int, unsigned int> > region_touching;
+                vector<unsigned int> frontier(1, seeds[rank]);
+                while (!frontier.empty()) {
+                    const unsigned int refpoint = frontier.back();
+                    frontier.pop_back();
+
+                    // Candidates of both shells, shared neighbors within the cutoff only
+                    vector<unsigned int> candidates;
+                    for (size_t edge = graph.offsets[refpoint]; edge < graph.offsets[refpoint + 1]; edge++) {
+                        const unsigned int point = graph.edges[edge];
+                        if (owner[point].load() != region && neighbors_ij.count(point) == 1)
+                            candidates.push_back(point);
+                    }
+
+                    vector<unsigned int> counts;
+                    const bool bulk = use_bulk_evaluation(candidates.size(), graph.degree(refpoint)) &&
+                                      shared_neighbor_counts(counts, neighbors_ij, refpoint, candidates);
+
+                    for (size_t i = 0; i < candidates.size(); i++) {
+                        const unsigned int point = candidates[i];
+                        const bool similar = bulk ? similarity(counts[i], refpoint, point)
+                                                  : similarity(neighbors_ij, refpoint, point);
+                        if (!similar) { continue; }
+
+                        // Either claim the point or remember the touching region
+                        claimed = 0;
+                        if (owner[point].compare_exchange_strong(claimed, region))
+                            frontier.push_back(point);
+                        else if (claimed != region)
+                            region_touching.emplace_back(region, claimed);
+                    }
+                }
+
+#pragma omp critical
+                touching.insert(touching.end(), region_touching.begin(), region_touching.end());
+            });
+
+            // Touching regions form one cluster
+            Clustering::Utility::DisjointSet regions(seeds.size() + 1);
+            for (auto const &pair : touching)
+                regions.unite(pair.first, pair.second);
+
+            // Clusters in the order of their first seed with ascending members
+            vector<int> cluster_of_root(seeds.size() + 1, -1);
+            vector<vector<unsigned int> > clusters;
+            for (unsigned int region = 1; region <= seeds.size(); region++) {
+                if (owner[seeds[region - 1]].load() != region) { continue; }
+                const unsigned int root = regions.find(region);
+                if (cluster_of_root[root] < 0) {
+                    cluster_of_root[root] = clusters.size();
+                    clusters.emplace_back();
+                }
+            }
+            for (unsigned int point = 0; point < num_points; point++) {
+                const unsigned int region = owner[point].load();
+                if (region > 0)
+                    clusters[cluster_of_root[regions.find(region)]].push_back(point);
+            }
+
+            // Seeds without similar neighbors are noise
+            clusters.erase(remove_if(clusters.begin(), clusters.end(),
+                                     [](const vector<unsigned int> &cluster) { return cluster.size() < 2; }),
+                           clusters.end());
+
+            return clusters;
+        }
+
+        // USER INTERFACE CLUSTERING
+        // Clusters the data
+        template<class Similarity>
+        vector<vector<unsigned int> >
+        algorithm(vector<vector<float> > &data,
+                  Neighbors &neighbors_ij,
+                  Neighbors &second_neighbors_ij,
+                  const float cut,
+                  const unsigned int sim,
+                  const unsigned int Nkeep,
+                  const bool mutual,
+                  const bool deterministic) {
+            // Each undirected edge of the neighbor graph is evaluated only once
+            // and, if not `mutual`, the rows comprise both shells.
+            Similarity policy(data, cut, sim);
+            Graph graph;
+            if (mutual)
+                nns::graph(graph, neighbors_ij);
+            else
+                nns::graph(graph, neighbors_ij, second_neighbors_ij);
+            if (Similarity::distance_dependent)
+                nns::distances(graph, data);
+            CachedSimilarity<Similarity> similarity(policy, graph);
+
+            map<unsigned int, int> clustered;
+            vector<vector<unsigned int> > clusters;
+
+            // sort by size of neighbor lists
+            vector<std::pair<unsigned int, unsigned int> > neighbor_list_sizes;
+            for (auto const &list : neighbors_ij) {
+                const unsigned int refpoint = list.first;
+                // Without `mutual` the second shell counts as well
+                unsigned int neighbor_list_size = graph.degree(refpoint);
+                neighbor_list_sizes.emplace_back(refpoint, neighbor_list_size);
+            }
+            // TODO : sorting can actually be removed. But for the sake of debugging we keep it right now.
+            sort(neighbor_list_sizes.begin(), neighbor_list_sizes.end(),
+                 [](const std::pair<unsigned int, unsigned int> &a,
+                    const std::pair<unsigned int, unsigned int> &b) {
+                     return a.second > b.second;
+                 });
+
+            if (deterministic) {
+                // Ties of the seed order are broken by the lower point such
+                // that the parallel sort gives the same order for any number
+                // of threads.
+                sort(neighbor_list_sizes.begin(), neighbor_list_sizes.end(),
+                     [](const std::pair<unsigned int, unsigned int> &a,
+                        const std::pair<unsigned int, unsigned int> &b) {
+                         return a.second > b.second || (a.second == b.second && a.first < b.first);
+                     });
+
+                for (auto const &it : neighbor_list_sizes) {
+                    const unsigned int refpoint = it.first;
+                    if (clustered.count(refpoint) == 1) { continue; }
+
+                    // Seeding is the expansion of a frontier with the `refpoint` only
+                    const int cluster_idx = clusters.size();
+                    vector<unsigned int> cluster(1, refpoint);
+                    clustered[refpoint] = cluster_idx;
+                    vector<unsigned int> frontier(1, refpoint);
+                    frontier = similarity_frontier(similarity, clustered, cluster, cluster_idx,
+                                                   neighbors_ij, graph, frontier);
+                    if (frontier.empty()) {
+                        clustered.erase(refpoint);
+                        continue;
+                    }
+
+                    // Add points until no new points are added to the cluster
+                    while (!frontier.empty())
+                        frontier = similarity_frontier(similarity, clustered, cluster, cluster_idx,
+                                                       neighbors_ij, graph, frontier);
+
+                    __gnu_parallel::sort(cluster.begin(), cluster.end());
+                    clusters.push_back(cluster);
+                }
+
+                Clustering::Utility::sortNclean(clusters, Nkeep, deterministic);
+
+                return clusters;
+            }
+
+            // With several threads, many regions grow at once
+            if (omp_get_max_threads() > 1) {
+                vector<unsigned int> seeds;
+                for (auto const &it : neighbor_list_sizes)
+                    seeds.push_back(it.first);
+                clusters = speculative_clusters(similarity, neighbors_ij, graph, seeds);
+
+                Clustering::Utility::sortNclean(clusters, Nkeep, true);
+
+                return clusters;
+            }
+
+            // Goes through all points/frames/keys with neighbor lists
+            unsigned prev_nof_clusters = clusters.size();
+            for (auto const &it : neighbor_list_sizes) {
+                const unsigned int refpoint = it.first;
+
+                // Try seeding new cluster on current `refpoint`
+                // exploiting its neighbor list or, given `mutual` is
+                // turned off, its row of both shells.
+                if (clustered.count(refpoint) == 0) {
+                    if (mutual)
+                        similarity_unclustered(similarity,
+                                               clustered,
+                                               clusters,
+                                               neighbors_ij,
+                                               neighbors_ij[refpoint],
+                                               refpoint);
+                    else
+                        similarity_unclustered(similarity,
+                                               clustered,
+                                               clusters,
+                                               neighbors_ij,
+                                               graph.row(refpoint),
+                                               refpoint);
+
+                    // Go to next neighbor list if the current `refpoint` did not generate a new cluster.
+                    if (clusters.size() > prev_nof_clusters) {
+                        prev_nof_clusters = clusters.size();
+                        const unsigned int cluster_idx = prev_nof_clusters - 1;
+
+                        // Try adding points until no new points are added to the cluster
+                        vector<unsigned int> to_consider(clusters[cluster_idx]);
+                        __gnu_parallel::sort(to_consider.begin(), to_consider.end());
+                        while (to_consider.size() > 0) {
+                            vector<unsigned int> prev_cluster(clusters[cluster_idx]);
+                            __gnu_parallel::sort(prev_cluster.begin(), prev_cluster.end());
+                            // Only reached with one thread, several threads grow speculative clusters
+                            for (auto const &clpoint : to_consider) {
+                                if (neighbors_ij.count(clpoint) == 0) { continue; }
+                                if (mutual)
+                                    similarity_clustered(similarity,
+                                                         clustered,
+                                                         clusters,
+                                                         neighbors_ij,
+                                                         neighbors_ij.at(clpoint),
+                                                         clpoint);
+                                else
+                                    similarity_clustered(similarity,
+                                                         clustered,
+                                                         clusters,
+                                                         neighbors_ij,
+                                                         graph.row(clpoint),
+                                                         clpoint);
+                            }
+                            vector<unsigned int> current_cluster(clusters[cluster_idx]);
+                            __gnu_parallel::sort(current_cluster.begin(), current_cluster.end());
+
+                            to_consider.clear();
+                            __gnu_parallel::set_difference(current_cluster.begin(),
+                                                           current_cluster.end(),
+                                                           prev_cluster.begin(),
+                                                           prev_cluster.end(),
+                                                           std::back_inserter(to_consider));
+                        }
+                    }
+                }
+            }
+
+            // Ascending members and the order of the speculative clusters,
+            // such that the output order does not depend on the number of threads
+            for (auto &cluster : clusters)
+                __gnu_parallel::sort(cluster.begin(), cluster.end());
+            Clustering::Utility::sortNclean(clusters, Nkeep, true);
+
+            return clusters;
+        }
+
+        template<class Similarity>
+        void edge_scores(vector<double> &scores,
+                         const Similarity &similarity,
+                         const Graph &graph,
+                         const Neighbors &neighbors_ij) {
+            scores.assign(graph.edges.size(), -std::numeric_limits<double>::infinity());
+
+            Clustering::Utility::parallel_tasks(graph.num_points(), 16, [&](const size_t point) {
+                if (graph.degree(point) == 0) { return; }
+
+                // Each undirected edge is evaluated from its lower point
+                vector<unsigned int> candidates;
+                vector<size_t> edges;
+                for (size_t edge = graph.offsets[point]; edge < graph.offsets[point + 1]; edge++) {
+                    const unsigned int neighbor = graph.edges[edge];
+                    if (neighbor > point && graph.degree(neighbor) > 0) {
+                        candidates.push_back(neighbor);
+                        edges.push_back(edge);
+                    }
+                }
+
+                vector<unsigned int> counts;
+                const bool bulk = use_bulk_evaluation(candidates.size(), graph.degree(point)) &&
+                                  shared_neighbor_counts(counts, neighbors_ij, point, candidates);
+
+                for (size_t i = 0; i < candidates.size(); i++) {
+                    size_t shared = 0;
+                    if (bulk) {
+                        shared = counts[i];
+                    } else {
+                        vector<unsigned int> shared_neighbors;
+                        intersection(shared_neighbors, neighbors_ij.at(point), neighbors_ij.at(candidates[i]));
+                        shared = shared_neighbors.size();
+                    }
+                    const double score = similarity.score(shared, point, candidates[i]);
+                    scores[edges[i]] = score;
+                    const size_t mirror = graph.edge(candidates[i], point);
+                    if (mirror != graph.edges.size())
+                        scores[mirror] = score;
+                }
+            });
+        }
+
+        // USER INTERFACE SIMILARITY SWEEP
+        template<class Similarity>
+        vector<vector<vector<unsigned int> > >
+        sweep(vector<vector<float> > &data,
+              Neighbors &neighbors_ij,
+              const float cut,
+              const vector<unsigned int> &sims,
+              const unsigned int Nkeep) {
+            Similarity similarity(data, cut, 0);
+            Graph graph;
+            nns::graph(graph, neighbors_ij);
+
+            // The only pass that intersects neighbor lists
+            vector<double> scores;
+            edge_scores(scores, similarity, graph, neighbors_ij);
+
+            // Undirected scored edges by decreasing score
+            vector<std::pair<double, std::pair<unsigned int, unsigned int> > > edges;
+            for (unsigned int point = 0; point < graph.num_points(); point++)
+                for (size_t edge = graph.offsets[point]; edge < graph.offsets[point + 1]; edge++)
+                    if (graph.edges[edge] > point && scores[edge] != -std::numeric_limits<double>::infinity())
+                        edges.emplace_back(scores[edge], std::make_pair(point, graph.edges[edge]));
+            __gnu_parallel::sort(edges.begin(), edges.end(),
+                                 [](const std::pair<double, std::pair<unsigned int, unsigned int> > &a,
+                                    const std::pair<double, std::pair<unsigned int, unsigned int> > &b) {
+                                     return a.first > b.first;
+                                 });
+
+            // Lowering the threshold only merges components, hence
+            // a single disjoint-set serves all `sims` in decreasing order.
+            vector<size_t> order(sims.size());
+            std::iota(order.begin(), order.end(), 0);
+            sort(order.begin(), order.end(),
+                 [&sims](const size_t a, const size_t b) { return sims[a] > sims[b]; });
+
+            vector<vector<vector<unsigned int> > > sweep_clusters(sims.size());
+            Clustering::Utility::DisjointSet components(graph.num_points());
+            size_t next_edge = 0;
+            for (auto const &idx : order) {
+                const double threshold = static_cast<double>(sims[idx]);
+                while (next_edge < edges.size() && edges[next_edge].first >= threshold) {
+                    components.unite(edges[next_edge].second.first, edges[next_edge].second.second);
+                    next_edge++;
+                }
+
+                vector<int> cluster_of_root(graph.num_points(), -1);
+                vector<vector<unsigned int> > &clusters = sweep_clusters[idx];
+                for (unsigned int point = 0; point < graph.num_points(); point++) {
+                    if (components.size(point) < 2) { continue; }
+                    const unsigned int root = components.find(point);
+                    if (cluster_of_root[root] < 0) {
+                        cluster_of_root[root] = clusters.size();
+                        clusters.emplace_back();
+                    }
+                    clusters[cluster_of_root[root]].push_back(point);
+                }
+                Clustering::Utility::sortNclean(clusters, Nkeep, true);
+            }
+
+            return sweep_clusters;
+        }
+
+        // The built-in similarity policies are instantiated in core.cpp
+        extern template void similarity_unclustered<CommonNearestNeighbor::Similarity>(
+                const CommonNearestNeighbor::Similarity &similarity,
+                map<unsigned int, int> &clustered,
+                vector<vector<unsigned int> > &clusters,
+                const Neighbors &neighbors_ij,
+                const vector<unsigned int> &input,
+                const unsigned int refpoint);
+
+        extern template void similarity_unclustered<CommonDensity::Similarity>(
+                const CommonDensity::Similarity &similarity,
+                map<unsigned int, int> &clustered,
+                vector<vector<unsigned int> > &clusters,
+                const Neighbors &neighbors_ij,
+                const vector<unsigned int> &input,
+                const unsigned int refpoint);
+
+        extern template void similarity_clustered<CommonNearestNeighbor::Similarity>(
+                const CommonNearestNeighbor::Similarity &similarity,
+                map<unsigned int, int> &clustered,
+                vector<vector<unsigned int> > &clusters,
+                const Neighbors &neighbors_ij,
+                const vector<unsigned int> &input,
+                const unsigned int refpoint);
+
+        extern template void similarity_clustered<CommonDensity::Similarity>(
+                const CommonDensity::Similarity &similarity,
+                map<unsigned int, int> &clustered,
+                vector<vector<unsigned int> > &clusters,
+                const Neighbors &neighbors_ij,
+                const vector<unsigned int> &input,
+                const unsigned int refpoint);
+
+        extern template vector<unsigned int> similarity_frontier<CommonNearestNeighbor::Similarity>(
+                const CommonNearestNeighbor::Similarity &similarity,
+                map<unsigned int, int> &clustered,
+                vector<unsigned int> &cluster,
+                const int cluster_idx,
+                const Neighbors &neighbors_ij,
+                const Graph &graph,
+                const vector<unsigned int> &frontier);
+
+        extern template vector<unsigned int> similarity_frontier<CommonDensity::Similarity>(
+                const CommonDensity::Similarity &similarity,
+                map<unsigned int, int> &clustered,
+                vector<unsigned int> &cluster,
+                const int cluster_idx,
+                const Neighbors &neighbors_ij,
+                const Graph &graph,
+                const vector<unsigned int> &frontier);
+
+        extern template vector<vector<unsigned int> > speculative_clusters<CommonNearestNeighbor::Similarity>(
+                const CommonNearestNeighbor::Similarity &similarity,
+                const Neighbors &neighbors_ij,
+                const Graph &graph,
+                const vector<unsigned int> &seeds);
+
+        extern template vector<vector<unsigned int> > speculative_clusters<CommonDensity::Similarity>(
+                const CommonDensity::Similarity &similarity,
+                const Neighbors &neighbors_ij,
+                const Graph &graph,
+                const vector<unsigned int> &seeds);
+
+        extern template vector<vector<unsigned int> >
+        algorithm<CommonNearestNeighbor::Similarity>(vector<vector<float> > &data,
+                                                     Neighbors &neighbors_ij,
+                                                     Neighbors &second_neighbors_ij,
+                                                     const float cut,
+                                                     const unsigned int sim,
+                                                     const unsigned int Nkeep,
+                                                     const bool mutual,
+                                                     const bool deterministic);
+
+        extern template vector<vector<unsigned int> >
+        algorithm<CommonDensity::Similarity>(vector<vector<float> > &data,
+                                             Neighbors &neighbors_ij,
+                                             Neighbors &second_neighbors_ij,
+                                             const float cut,
+                                             const unsigned int sim,
+                                             const unsigned int Nkeep,
+                                             const bool mutual,
+                                             const bool deterministic);
+
+        extern template vector<vector<vector<unsigned int> > >
+        sweep<CommonNearestNeighbor::Similarity>(vector<vector<float> > &data,
+                                                 Neighbors &neighbors_ij,
+                                                 const float cut,
+                                                 const vector<unsigned int> &sims,
+                                                 const unsigned int Nkeep);
+
+        extern template vector<vector<vector<unsigned int> > >
+        sweep<CommonDensity::Similarity>(vector<vector<float> > &data,
+                                         Neighbors &neighbors_ij,
+                                         const float cut,
+                                         const vector<unsigned int> &sims,
+                                         const unsigned int Nkeep);
+
+    } // end namespace Core
+} // end namespace Clustering
+
+#endif //CLUSTERING_CORE_IMPL_H
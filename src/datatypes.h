@@ -30,9 +30,57 @@ SOFTWARE
 #include <vector>
 #include <unordered_map>
 #include <map>
+#include <algorithm>
+#include <iterator>
 
 typedef std::map<unsigned int, std::vector<unsigned int>> Neighbors;
 
+// Neighbor lists in compressed sparse row (CSR) format. The sorted
+// neighbor list of `point` is stored in `edges` between
+// offsets[point] and offsets[point + 1], such that every directed
+// edge (point, neighbor) has a unique position in `edges`.
+typedef struct Graph {
+
+    Graph() : offsets(1, 0) {}
+
+    unsigned int num_points() const { return offsets.size() - 1; }
+
+    size_t degree(const unsigned int point) const {
+        if (point >= num_points()) return 0;
+        return offsets[point + 1] - offsets[point];
+    }
+
+    // Position of the edge (point, neighbor) in `edges`
+    // or `edges.size()` if `neighbor` is not a neighbor of `point`.
+    size_t edge(const unsigned int point, const unsigned int neighbor) const {
+        if (point >= num_points()) return edges.size();
+        auto first = edges.begin() + offsets[point];
+        auto last = edges.begin() + offsets[point + 1];
+        auto it = std::lower_bound(first, last, neighbor);
+        return (it != last && *it == neighbor) ? static_cast<size_t>(it - edges.begin()) : edges.size();
+    }
+
+    std::vector<unsigned int> row(const unsigned int point) const {
+        if (point >= num_points()) return std::vector<unsigned int>();
+        return std::vector<unsigned int>(edges.begin() + offsets[point], edges.begin() + offsets[point + 1]);
+    }
+
+    // Whether the edge is within the cutoff or only within the second
+    // shell of twice the cutoff (non-mutual mode)
+    bool second_shell(const size_t edge) const {
+        return !shells.empty() && shells[edge] != 0;
+    }
+
+    std::vector<size_t> offsets;
+    std::vector<unsigned int> edges;
+    // Shell marker of every edge, empty if all edges are within the cutoff
+    std::vector<unsigned char> shells;
+    // Distance of the points of every edge, empty if not annotated.
+    // Graphs of hierarchy levels hold squared distances instead.
+    std::vector<float> distances;
+
+} Graph;
+
 typedef struct clstep {
 
     clstep() : step(0), cut(0.0), sim(0) {}
@@ -46,4 +94,104 @@ typedef struct clstep {
 
 } clstep;
 
+typedef struct HierarchyNode {
+
+    HierarchyNode() : parent(-1), begin(0), end(0), first_child(0), num_children(0) {}
+
+    HierarchyNode(long prnt, clstep stp, size_t bgn, size_t nd) :
+            parent(prnt), step(stp), begin(bgn), end(nd), first_child(0), num_children(0) {}
+
+    size_t size() const { return end - begin; }
+
+    bool leaf() const { return num_children == 0; }
+
+    // Parent node or -1 for the clusters of the initial clustering
+    long parent;
+    // Level, cut and similarity of the clustering that yielded the node
+    clstep step;
+    // Members of the node in Hierarchy::members
+    size_t begin;
+    size_t end;
+    // Children are consecutive in Hierarchy::nodes
+    size_t first_child;
+    size_t num_children;
+
+} HierarchyNode;
+
+// Tree of a hierarchical clustering. Every node owns the range of its
+// members in the single permutation `members`. The children of a node
+// own consecutive ranges at the front of the range of their parent,
+// which ends with the members that were not clustered again.
+typedef struct Hierarchy {
+
+    // Add clusters of the initial clustering as roots
+    void add_roots(const std::vector<std::vector<unsigned int> > &clusters, const clstep &step) {
+        for (auto const &cluster : clusters) {
+            nodes.emplace_back(-1, step, members.size(), members.size() + cluster.size());
+            members.insert(members.end(), cluster.begin(), cluster.end());
+        }
+    }
+
+    // Split a leaf into clusters of its members, which become its children
+    void split(const size_t node, const std::vector<std::vector<unsigned int> > &clusters, const clstep &step) {
+        const size_t first(nodes[node].begin), last(nodes[node].end);
+        std::vector<unsigned int> clustered;
+        for (auto const &cluster : clusters)
+            clustered.insert(clustered.end(), cluster.begin(), cluster.end());
+        std::vector<unsigned int> all(members.begin() + first, members.begin() + last);
+        std::vector<unsigned int> sorted(clustered);
+        std::sort(all.begin(), all.end());
+        std::sort(sorted.begin(), sorted.end());
+        std::vector<unsigned int> rest;
+        std::set_difference(all.begin(), all.end(), sorted.begin(), sorted.end(), std::back_inserter(rest));
+
+        nodes[node].first_child = nodes.size();
+        nodes[node].num_children = clusters.size();
+        size_t begin(first);
+        for (auto const &cluster : clusters) {
+            nodes.emplace_back(static_cast<long>(node), step, begin, begin + cluster.size());
+            begin += cluster.size();
+        }
+        std::copy(clustered.begin(), clustered.end(), members.begin() + first);
+        std::copy(rest.begin(), rest.end(), members.begin() + first + clustered.size());
+    }
+
+    std::vector<unsigned int> cluster(const size_t node) const {
+        return std::vector<unsigned int>(members.begin() + nodes[node].begin, members.begin() + nodes[node].end);
+    }
+
+    // Leaves in depth-first order, i.e., the order of the final clusters
+    std::vector<size_t> leaves() const {
+        std::vector<size_t> result;
+        std::vector<size_t> stack;
+        for (size_t node = nodes.size(); node-- > 0;)
+            if (nodes[node].parent < 0) stack.push_back(node);
+        while (!stack.empty()) {
+            const size_t node(stack.back());
+            stack.pop_back();
+            if (nodes[node].leaf())
+                result.push_back(node);
+            else
+                for (size_t child = nodes[node].num_children; child-- > 0;)
+                    stack.push_back(nodes[node].first_child + child);
+        }
+        return result;
+    }
+
+    // Clusters of the leaves in depth-first order and their steps
+    std::vector<std::vector<unsigned int> > leaf_clusters(std::vector<clstep> &steps) const {
+        std::vector<std::vector<unsigned int> > clusters;
+        steps.clear();
+        for (auto const &leaf : leaves()) {
+            clusters.push_back(cluster(leaf));
+            steps.push_back(nodes[leaf].step);
+        }
+        return clusters;
+    }
+
+    std::vector<HierarchyNode> nodes;
+    std::vector<unsigned int> members;
+
+} Hierarchy;
+
 #endif //CNN_DATATYPES_H
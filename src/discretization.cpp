@@ -23,39 +23,56 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE
 */
 
+#include <numeric> // std::partial_sum
+#include <stdexcept>
+
+#include "tools/utility.h"
+
 #include "discretization.h"
 
 namespace Clustering {
 
     namespace Discretization {
 
+        vector<size_t> offsets(const vector<unsigned int> &traj_shapes) {
+            vector<size_t> offsets(traj_shapes.size() + 1, 0);
+            std::partial_sum(traj_shapes.begin(), traj_shapes.end(), offsets.begin() + 1);
+            return offsets;
+        }
+
+        vector<int> labels(const vector<vector<unsigned int> > &clusters,
+                           const size_t num_frames) {
+            for (auto const &cluster : clusters)
+                for (auto const &idx : cluster)
+                    if (idx >= num_frames)
+                        throw std::out_of_range("A cluster contains a frame beyond the trajectories.");
+
+            vector<int> labels(num_frames, -1);
+            Clustering::Utility::parallel_tasks(clusters.size(), 1, [&](const size_t cluster_idx) {
+                for (auto const &idx : clusters[cluster_idx])
+                    labels[idx] = static_cast<int>(cluster_idx);
+            });
+            return labels;
+        }
+
         // USER INTERFACE DISCRETIZATION
         // Retrieves the discretized tajectories
         vector<vector<int> > dtrajs(const vector<vector<unsigned int> > &clusters,
                                     const vector<unsigned int> &traj_shapes) {
+            return dtrajs(labels(clusters, offsets(traj_shapes).back()), traj_shapes);
+        }
 
-            vector<vector<int> > dtrajs;
-            for (auto shape : traj_shapes)
-                dtrajs.push_back(vector<int>(shape, -1));
-
-            for (int i = 0; i < clusters.size(); i++) {
-                int cn = i; // cluster number
-                for (auto idx : clusters[i]) {
-
-                    unsigned int concat = 0;
-                    unsigned int traj_idx = 0;
-                    while (concat <= idx && traj_idx < traj_shapes.size()) {
-                        concat += traj_shapes[traj_idx];
-                        ++traj_idx;
-                    }
-                    --traj_idx;
-                    concat -= traj_shapes[traj_idx];
-
-                    unsigned int frame_idx = idx - concat;
-                    dtrajs[traj_idx][frame_idx] = cn;
-                }
-            }
+        vector<vector<int> > dtrajs(const vector<int> &labels,
+                                    const vector<unsigned int> &traj_shapes) {
+            const vector<size_t> traj_offsets(offsets(traj_shapes));
+            if (labels.size() != traj_offsets.back())
+                throw std::invalid_argument("The labels must cover all frames of the trajectories.");
 
+            vector<vector<int> > dtrajs(traj_shapes.size());
+            Clustering::Utility::parallel_tasks(traj_shapes.size(), 16, [&](const size_t traj_idx) {
+                dtrajs[traj_idx].assign(labels.begin() + traj_offsets[traj_idx],
+                                        labels.begin() + traj_offsets[traj_idx + 1]);
+            });
             return dtrajs;
         }
 
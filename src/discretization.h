@@ -38,10 +38,24 @@ namespace Clustering {
 
     namespace Discretization {
 
+        // Offset of every trajectory in the concatenated frames and the
+        // total number of frames as last element, i.e., prefix sums
+        vector<size_t> offsets(const vector<unsigned int> &traj_shapes);
+
+        // Cluster index of each of `num_frames` concatenated frames or -1
+        // for noise. The clusters are disjoint and scattered in parallel.
+        vector<int> labels(const vector<vector<unsigned int> > &clusters,
+                           const size_t num_frames);
+
         // USER INTERFACE DISCRETIZATION
         // Retrieves the discretized tajectories
         vector<vector<int> > dtrajs(const vector<vector<unsigned int> > &clusters,
                                     const vector<unsigned int> &traj_shapes);
+
+        // Discretized trajectories from the labels of the concatenated frames,
+        // which are already the concatenated trajectories, see write_dtrajs
+        vector<vector<int> > dtrajs(const vector<int> &labels,
+                                    const vector<unsigned int> &traj_shapes);
     }
 }
 
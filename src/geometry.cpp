@@ -27,6 +27,12 @@ SOFTWARE
 #include <boost/math/special_functions/gamma.hpp>
 #include <boost/math/special_functions/beta.hpp>
 
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <mutex>
+#include <utility>
+
 #include "geometry.h"
 
 namespace Geometry {
@@ -44,4 +50,74 @@ namespace Geometry {
         return incomplete_beta;
     }
 
+    // Relative slack on the tabulated nodes which covers the rounding
+    // error of the incomplete beta function
+    static const double node_slack = 1.0e-10;
+
+    IntersectionVolumeTable::IntersectionVolumeTable(const double cut,
+                                                     const unsigned int n,
+                                                     const size_t intervals) :
+            cut_(cut),
+            n_(n),
+            step_(2.0 * cut / static_cast<double>(intervals > 0 ? intervals : 1)),
+            distances_((intervals > 0 ? intervals : 1) + 1),
+            volumes_((intervals > 0 ? intervals : 1) + 1),
+            error_bound_(0.0) {
+        const size_t nodes(distances_.size());
+        for (size_t i = 0; i < nodes; ++i) {
+            distances_[i] = (i + 1 == nodes) ? 2.0 * cut : static_cast<double>(i) * step_;
+            // the hyperspheres only touch at twice the cutoff
+            volumes_[i] = (i + 1 == nodes) ? 0.0 : regularized_intersection_volume(distances_[i], cut, n);
+        }
+        for (size_t i = 0; i + 1 < nodes; ++i) {
+            error_bound_ = std::max(error_bound_, volumes_[i] - volumes_[i + 1]);
+        }
+    }
+
+    std::shared_ptr<const IntersectionVolumeTable> IntersectionVolumeTable::shared(const double cut,
+                                                                                   const unsigned int n) {
+        // a hierarchy needs one table per level, the limit only bounds
+        // the memory of long running sessions with many different cutoffs
+        static const size_t max_tables = 64;
+        static std::mutex mutex;
+        static std::map<std::pair<double, unsigned int>, std::shared_ptr<const IntersectionVolumeTable> > tables;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = tables.find(std::make_pair(cut, n));
+        if (it != tables.end()) return it->second;
+        if (tables.size() >= max_tables) tables.clear();
+        auto table = std::make_shared<const IntersectionVolumeTable>(cut, n);
+        tables.emplace(std::make_pair(cut, n), table);
+        return table;
+    }
+
+    // Index of the node interval [distances_[i], distances_[i + 1]] that
+    // contains `distance`, or the number of intervals if there is none
+    size_t IntersectionVolumeTable::interval(const double distance) const {
+        const size_t intervals(distances_.size() - 1);
+        if (!(step_ > 0.0) || !(distance >= 0.0) || distance > distances_[intervals]) return intervals;
+        size_t i(std::min(static_cast<size_t>(distance / step_), intervals - 1));
+        // the division may round across a node
+        while (i > 0 && distance < distances_[i]) --i;
+        while (i + 1 < intervals && distance > distances_[i + 1]) ++i;
+        return i;
+    }
+
+    double IntersectionVolumeTable::operator()(const double distance) const {
+        const size_t i(interval(distance));
+        if (i + 1 == distances_.size()) return (distance > 0.0) ? 0.0 : 1.0;
+        const double t((distance - distances_[i]) / (distances_[i + 1] - distances_[i]));
+        return volumes_[i] + t * (volumes_[i + 1] - volumes_[i]);
+    }
+
+    bool IntersectionVolumeTable::bounds(const double distance,
+                                         double &lower,
+                                         double &upper) const {
+        const size_t i(interval(distance));
+        if (i + 1 == distances_.size()) return false;
+        lower = volumes_[i + 1] * (1.0 - node_slack);
+        upper = volumes_[i] * (1.0 + node_slack);
+        return true;
+    }
+
 }
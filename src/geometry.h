@@ -26,6 +26,8 @@ SOFTWARE
 #ifndef CLUSTERING_GEOMETRY_H
 #define CLUSTERING_GEOMETRY_H
 
+#include <cstddef>
+#include <memory>
 #include <vector>
 
 namespace Geometry {
@@ -34,6 +36,51 @@ namespace Geometry {
                                            const double cut,
                                            const unsigned int n);
 
+    // Regularized intersection volume of a fixed cutoff and
+    // dimensionality tabulated at equidistant distances in [0, 2 * cut].
+    // The volume decreases monotonically with the distance, so the two
+    // nodes around a distance bracket its exact volume and the linear
+    // interpolation between them is itself monotone with an absolute
+    // error of at most `error_bound()`.
+    class IntersectionVolumeTable {
+    public:
+        IntersectionVolumeTable(const double cut,
+                                const unsigned int n,
+                                const size_t intervals = 1024);
+
+        // Table of a cutoff and dimensionality shared with all other
+        // callers of the same run, e.g., the clusters of a hierarchy level
+        static std::shared_ptr<const IntersectionVolumeTable> shared(const double cut,
+                                                                     const unsigned int n);
+
+        // Linear interpolation of the volume at `distance`
+        double operator()(const double distance) const;
+
+        // Lower and upper bound of the exact volume at `distance`.
+        // Returns false if the distance is outside of the table.
+        bool bounds(const double distance,
+                    double &lower,
+                    double &upper) const;
+
+        // Largest difference of adjacent nodes, i.e., the guaranteed
+        // absolute error of the interpolation
+        double error_bound() const { return error_bound_; }
+
+        double cut() const { return cut_; }
+
+        unsigned int dimensions() const { return n_; }
+
+    private:
+        size_t interval(const double distance) const;
+
+        const double cut_;
+        const unsigned int n_;
+        const double step_;
+        std::vector<double> distances_;
+        std::vector<double> volumes_;
+        double error_bound_;
+    };
+
 }
 
 #endif //CLUSTERING_GEOMETRY_H
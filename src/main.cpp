@@ -37,6 +37,11 @@ int main(int argc, char *argv[]) {
     ArgParse &args(*new ArgParse(argc, argv));
 
     args.flag<bool>("-CNN", false);
+    args.flag<bool>("--deterministic", false);
+    args.flag<bool>("--fast", false);
+    args.flag<bool>("--resume", false);
+    args.flag<bool>("--descend", false);
+    args.flag<bool>("--incremental", false);
     const auto cut(args.flag<float>("-cut", std::numeric_limits<float>::max()));
     const auto sim(args.flag<unsigned int>("-sim", 0));
     const auto nsteps(args.flag<unsigned int>("-nsteps", 0));
@@ -51,7 +56,9 @@ int main(int argc, char *argv[]) {
     const auto do_clustering(args.flag<bool>("clustering", false));
     const auto do_hierarchic(args.flag<bool>("hierarchic", false));
     const auto do_scan(args.flag<bool>("scan", false));
+    const auto do_sweep(args.flag<bool>("sweep", false));
     const auto mutual(args.flag<bool>("mutual", true));
+    const auto nonmutual(args.flag<bool>("-nonmutual", false));
     const auto do_mapping(args.flag<bool>("mapping", false));
     const auto do_dtrajs(args.flag<bool>("dtrajs", false));
     const auto overwrite(args.flag<bool>("--overwrite", true));
@@ -67,13 +74,29 @@ int main(int argc, char *argv[]) {
         std::cout << " HIEARCHICAL DENSITY-BASED CLUSTERING " << std::endl;
         std::cout << "Use via `comdensity MODES OPTIONS`." << std::endl;
         std::cout << "For instance, run `comdensity clustering -dfile input.npy -cut 0.5 -sim 2`." << std::endl;
-        std::cout << "MODES: clustering | scan | hierarchic | mapping | dtrajs" << std::endl;
+        std::cout << "MODES: clustering | scan | sweep | hierarchic | mapping | dtrajs" << std::endl;
         std::cout << "OPTIONS:" << std::endl;
         std::cout << "-cut\tHyperspherical cutoff radius R (default: " << cut << ")" << std::endl;
         std::cout << "-sim\tSimilarity N (default: " << sim << ")" << std::endl;
         std::cout << "-dcut\tStep size for increasing R, must be negative (default: " << delta_cut << ")" << std::endl;
+        std::cout << "-dsim\tStep size for increasing N (default: " << delta_sim << ")" << std::endl;
         std::cout << "-nsteps\tNumber of steps to increase R during scanning funcionality (default: " << nsteps << ")"
                   << std::endl;
+        std::cout << "\tThe sweep mode clusters all similarities N + i * dsim at fixed R from one pass." << std::endl;
+        std::cout << "-nonmutual\tAlso consider pairs within 2R that are not neighbors (default: " << nonmutual << ")"
+                  << std::endl;
+        std::cout << "--deterministic\tSame clusters and order for any number of threads (default: off)" << std::endl;
+        std::cout << "--fast\tHierarchic levels from the neighbors of the first level only (default: off)" << std::endl;
+        std::cout << "\tThe clusters are those of --deterministic." << std::endl;
+        std::cout << "--resume\tHierarchic levels continue from the checkpoint of an interrupted run (default: off)"
+                  << std::endl;
+        std::cout << "\tThe checkpoint is the `-tree.bin.ckpt` file of -hfile and must match data and options."
+                  << std::endl;
+        std::cout << "--incremental\tClustering only adds the frames appended since the last run (default: off)"
+                  << std::endl;
+        std::cout << "\tThe components of the last run are kept in the `-components.bin` file of -cfile." << std::endl;
+        std::cout << "--descend\tMapping descends the hierarchy tree of -hfile instead of testing all leaves"
+                  << " (default: off)" << std::endl;
         std::cout << "-slice\tSlice of input data (default: " << slice << ")" << std::endl;
         std::cout << "-ndims\tNumber of dimensions of input data (default: " << ndims << ")" << std::endl;
         std::cout << std::endl;
@@ -124,6 +147,10 @@ int main(int argc, char *argv[]) {
         Clustering::Wrapper::scan(clusters, leaves, args);
     }
 
+    if (do_sweep) {
+        Clustering::Wrapper::sweep(clusters, leaves, args);
+    }
+
     if (do_clustering || do_hierarchic) {
         Clustering::Wrapper::clustering(clusters, leaves, args);
         if (do_hierarchic) {
@@ -23,9 +23,17 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE
 */
 
+#include <cmath>
+#include <limits>
+#include <numeric> // std::partial_sum, std::iota
+#include <stdexcept>
+#include <utility>
+
 #include <omp.h>
 #include <parallel/algorithm>
 
+#include "tools/utility.h"
+
 #include "neighbors.h"
 
 namespace nns {
@@ -263,7 +271,349 @@ namespace nns {
                 neighbors_ij.erase(key);
     }
 
+    void graph(Graph &graph,
+               const Neighbors &neighbors_ij) {
+        // The rows have to cover every point that occurs as key or as neighbor
+        unsigned int num_points(0);
+        for (auto const &list : neighbors_ij) {
+            num_points = std::max(num_points, list.first + 1);
+            if (!list.second.empty())
+                num_points = std::max(num_points, list.second.back() + 1);
+        }
+
+        graph.offsets.assign(num_points + 1, 0);
+        for (auto const &list : neighbors_ij)
+            graph.offsets[list.first + 1] = list.second.size();
+        std::partial_sum(graph.offsets.begin(), graph.offsets.end(), graph.offsets.begin());
+
+        graph.edges.resize(graph.offsets.back());
+        for (auto const &list : neighbors_ij)
+            std::copy(list.second.begin(), list.second.end(), graph.edges.begin() + graph.offsets[list.first]);
+    }
+
+    void graph(Graph &graph,
+               const Neighbors &neighbors_ij,
+               const Neighbors &second_neighbors_ij) {
+        unsigned int num_points(0);
+        for (auto const *lists : {&neighbors_ij, &second_neighbors_ij})
+            for (auto const &list : *lists) {
+                num_points = std::max(num_points, list.first + 1);
+                if (!list.second.empty())
+                    num_points = std::max(num_points, list.second.back() + 1);
+            }
+
+        graph.offsets.assign(num_points + 1, 0);
+        for (auto const *lists : {&neighbors_ij, &second_neighbors_ij})
+            for (auto const &list : *lists)
+                graph.offsets[list.first + 1] += list.second.size();
+        std::partial_sum(graph.offsets.begin(), graph.offsets.end(), graph.offsets.begin());
+
+        // Both lists are sorted and disjoint, thus, merging keeps the rows sorted
+        const vector<unsigned int> empty;
+        graph.edges.resize(graph.offsets.back());
+        graph.shells.resize(graph.offsets.back());
+        for (unsigned int point = 0; point < num_points; point++) {
+            auto first_it = neighbors_ij.find(point);
+            auto second_it = second_neighbors_ij.find(point);
+            const vector<unsigned int> &first = (first_it != neighbors_ij.end()) ? first_it->second : empty;
+            const vector<unsigned int> &second = (second_it != second_neighbors_ij.end()) ? second_it->second : empty;
+
+            size_t i = 0, j = 0, edge = graph.offsets[point];
+            while (i < first.size() || j < second.size()) {
+                if (j == second.size() || (i < first.size() && first[i] < second[j])) {
+                    graph.edges[edge] = first[i++];
+                    graph.shells[edge] = 0;
+                } else {
+                    graph.edges[edge] = second[j++];
+                    graph.shells[edge] = 1;
+                }
+                edge++;
+            }
+        }
+    }
+
+    float distance(const vector<float> &point1,
+                   const vector<float> &point2) {
+        const unsigned int ndims(point1.size());
+        float dist(0.0);
+#pragma omp simd reduction(+:dist)
+        for (unsigned int k = 0; k < ndims; k++) {
+            float d(point1[k] - point2[k]);
+            dist += (d * d);
+        }
+        return std::sqrt(dist);
+    }
+
+    void distances(Graph &graph,
+                   const vector<vector<float> > &data) {
+        graph.distances.resize(graph.edges.size());
+        Clustering::Utility::parallel_tasks(graph.num_points(), 64, [&](const size_t point) {
+            for (size_t edge = graph.offsets[point]; edge < graph.offsets[point + 1]; edge++)
+                graph.distances[edge] = distance(data[point], data[graph.edges[edge]]);
+        });
+    }
+
+    ////////////// HIERARCHY UTILITY ///////////////
+    void cluster_graph(Graph &graph,
+                       const vector<vector<unsigned int> > &clusters,
+                       const vector<vector<float> > &data,
+                       const float radiussquare) {
+        const unsigned int num_frames(data.size());
+        const unsigned int ndims(num_frames > 0 ? data[0].size() : 0);
+        vector<unsigned int> points;
+        for (auto const &cluster : clusters)
+            points.insert(points.end(), cluster.begin(), cluster.end());
+
+        // Rows are scanned in parallel and copied into place afterwards
+        vector<vector<unsigned int> > rows(points.size());
+        vector<vector<float> > row_distances(points.size());
+        Clustering::Utility::parallel_tasks(points.size(), 16, [&](const size_t i) {
+            const unsigned int refpoint(points[i]);
+            for (unsigned int j = 0; j < num_frames; ++j) {
+                if (j == refpoint) continue;
+
+                // Calculate distance as in calc_neighbors
+                float dist(0.0);
+#pragma omp simd reduction(+:dist)
+                for (unsigned int k = 0; k < ndims; ++k) {
+                    float d(data[refpoint][k] - data[j][k]);
+                    dist += (d * d);
+                }
+
+                if (dist <= radiussquare) {
+                    rows[i].push_back(j);
+                    row_distances[i].push_back(dist);
+                }
+            }
+        });
+
+        graph.offsets.assign(num_frames + 1, 0);
+        for (size_t i = 0; i < points.size(); i++)
+            graph.offsets[points[i] + 1] = rows[i].size();
+        std::partial_sum(graph.offsets.begin(), graph.offsets.end(), graph.offsets.begin());
+
+        graph.edges.resize(graph.offsets.back());
+        graph.distances.resize(graph.offsets.back());
+        graph.shells.clear();
+        for (size_t i = 0; i < points.size(); i++) {
+            std::copy(rows[i].begin(), rows[i].end(), graph.edges.begin() + graph.offsets[points[i]]);
+            std::copy(row_distances[i].begin(), row_distances[i].end(),
+                      graph.distances.begin() + graph.offsets[points[i]]);
+        }
+    }
+
+    void filter_graph(Graph &graph,
+                      const vector<vector<unsigned int> > &clusters,
+                      const float radiussquare) {
+        vector<char> kept(graph.num_points(), 0);
+        for (auto const &cluster : clusters)
+            for (auto const &point : cluster)
+                if (point < kept.size()) kept[point] = 1;
+
+        // Rows only shrink, thus, the graph is compacted in place
+        size_t edge(0);
+        for (unsigned int point = 0; point < graph.num_points(); point++) {
+            const size_t first(graph.offsets[point]), last(graph.offsets[point + 1]);
+            graph.offsets[point] = edge;
+            if (kept[point] == 0) continue;
+            for (size_t old_edge = first; old_edge < last; old_edge++) {
+                if (graph.distances[old_edge] <= radiussquare) {
+                    graph.edges[edge] = graph.edges[old_edge];
+                    graph.distances[edge] = graph.distances[old_edge];
+                    edge++;
+                }
+            }
+        }
+        graph.offsets.back() = edge;
+        graph.edges.resize(edge);
+        graph.distances.resize(edge);
+    }
+
+    void neighbors_from_graph(Neighbors &neighbors_ij,
+                              Neighbors &second_neighbors_ij,
+                              const vector<unsigned int> &cluster,
+                              const Graph &graph,
+                              const float cut,
+                              const unsigned int sim,
+                              const bool mutual) {
+        const float cutsquare(cut * cut);
+        const float fourcutsquare(4.0f * cutsquare);
+
+        Clustering::Utility::parallel_tasks(cluster.size(), 64, [&](const size_t i) {
+            unsigned int refpoint(cluster[i]);
+
+            // Same shells as calc_neighbors on the stored squared distances
+            vector<unsigned int> neighbors_i;
+            vector<unsigned int> second_neighbors_i;
+            if (refpoint < graph.num_points()) {
+                for (size_t edge = graph.offsets[refpoint]; edge < graph.offsets[refpoint + 1]; edge++) {
+                    const float dist(graph.distances[edge]);
+                    if (dist <= cutsquare)
+                        neighbors_i.push_back(graph.edges[edge]);
+                    else if (!mutual && dist <= fourcutsquare)
+                        second_neighbors_i.push_back(graph.edges[edge]);
+                }
+            }
+
+            // Only add neighbor list to the std::map if it
+            // comprises more than similarity + 1 neighbors
+#pragma omp critical
+            if (neighbors_i.size() >= sim + 1) {
+                neighbors_ij[refpoint] = neighbors_i;
+                if (!mutual && second_neighbors_i.size() != 0) {
+                    second_neighbors_ij[refpoint] = second_neighbors_i;
+                }
+            }
+        });
+    }
+
+    void compact(Neighbors &neighbors_ij,
+                 Neighbors &second_neighbors_ij,
+                 vector<unsigned int> &points) {
+        // Dense lookup of this thread from original to new indices, which
+        // is only touched at the points of the lists and reset afterwards
+        static thread_local vector<unsigned int> lookup;
+        const unsigned int unset(std::numeric_limits<unsigned int>::max());
+
+        points.clear();
+        auto visit = [&](const unsigned int point) {
+            if (point >= lookup.size()) lookup.resize(point + 1, unset);
+            if (lookup[point] == unset) {
+                lookup[point] = 0;
+                points.push_back(point);
+            }
+        };
+        for (auto const *lists : {&neighbors_ij, &second_neighbors_ij})
+            for (auto const &list : *lists) {
+                visit(list.first);
+                for (auto const &neighbor : list.second)
+                    visit(neighbor);
+            }
+
+        // Monotone, thus, the renumbered lists remain sorted
+        __gnu_parallel::sort(points.begin(), points.end(), __gnu_parallel::sequential_tag());
+        for (size_t i = 0; i < points.size(); i++)
+            lookup[points[i]] = i;
+        for (auto *lists : {&neighbors_ij, &second_neighbors_ij}) {
+            Neighbors renumbered;
+            for (auto &list : *lists) {
+                for (auto &neighbor : list.second)
+                    neighbor = lookup[neighbor];
+                renumbered.emplace_hint(renumbered.end(), lookup[list.first], std::move(list.second));
+            }
+            lists->swap(renumbered);
+        }
+
+        for (auto const &point : points)
+            lookup[point] = unset;
+    }
+
     ////////////// MAPPING UTILITY ///////////////
+    static vector<unsigned int> all_points(const size_t num_points) {
+        vector<unsigned int> points(num_points);
+        std::iota(points.begin(), points.end(), 0);
+        return points;
+    }
+
+    RadiusIndex::RadiusIndex(const vector<vector<float> > &data,
+                             const unsigned int leaf_size) :
+            RadiusIndex(data, all_points(data.size()), leaf_size) {}
+
+    RadiusIndex::RadiusIndex(const vector<vector<float> > &data,
+                             const vector<unsigned int> &points,
+                             const unsigned int leaf_size) :
+            ndims_(data.empty() ? 0 : data[0].size()), indices_(points) {
+        if (indices_.empty()) { return; }
+
+        // Nodes are split at the median of the dimension of their largest
+        // extent, such that the tree is balanced. Children are added in
+        // pairs, i.e., with consecutive indices.
+        nodes_.push_back({0, indices_.size(), 0});
+        vector<size_t> pending(1, 0);
+        while (!pending.empty()) {
+            const size_t node(pending.back());
+            pending.pop_back();
+            const size_t begin(nodes_[node].begin), end(nodes_[node].end);
+
+            vector<float> lower(data[indices_[begin]]), upper(data[indices_[begin]]);
+            for (size_t i = begin + 1; i < end; ++i)
+                for (unsigned int k = 0; k < ndims_; ++k) {
+                    lower[k] = std::min(lower[k], data[indices_[i]][k]);
+                    upper[k] = std::max(upper[k], data[indices_[i]][k]);
+                }
+            bounds_.resize(2 * ndims_ * nodes_.size());
+            std::copy(lower.begin(), lower.end(), bounds_.begin() + 2 * ndims_ * node);
+            std::copy(upper.begin(), upper.end(), bounds_.begin() + 2 * ndims_ * node + ndims_);
+            if (end - begin <= leaf_size) { continue; }
+
+            unsigned int dim(0);
+            for (unsigned int k = 1; k < ndims_; ++k)
+                if (upper[k] - lower[k] > upper[dim] - lower[dim]) { dim = k; }
+            const size_t middle(begin + (end - begin) / 2);
+            std::nth_element(indices_.begin() + begin, indices_.begin() + middle, indices_.begin() + end,
+                             [&data, dim](const unsigned int a, const unsigned int b) {
+                                 return data[a][dim] < data[b][dim];
+                             });
+            nodes_[node].left = nodes_.size();
+            nodes_.push_back({begin, middle, 0});
+            nodes_.push_back({middle, end, 0});
+            pending.push_back(nodes_[node].left);
+            pending.push_back(nodes_[node].left + 1);
+        }
+        bounds_.resize(2 * ndims_ * nodes_.size());
+
+        points_.resize(indices_.size() * ndims_);
+        for (size_t i = 0; i < indices_.size(); ++i)
+            std::copy(data[indices_[i]].begin(), data[indices_[i]].end(), points_.begin() + i * ndims_);
+    }
+
+    GridIndex::GridIndex(const float width,
+                         const unsigned int grid_dims) :
+            width_(width), grid_dims_(grid_dims < 3 ? grid_dims : 3), ndims_(0), dims_(0), size_(0) {
+        if (!(width > 0.0f))
+            throw std::invalid_argument("The width of the grid cells must be positive.");
+    }
+
+    GridIndex::Key GridIndex::key(const vector<float> &point) const {
+        Key key{};
+        for (unsigned int k = 0; k < dims_; ++k)
+            key[k] = coordinate(point[k]);
+        return key;
+    }
+
+    void GridIndex::insert(const size_t id,
+                           const vector<float> &point) {
+        if (size_ == 0) {
+            ndims_ = point.size();
+            dims_ = std::min(grid_dims_, ndims_);
+        } else if (point.size() != ndims_) {
+            throw std::invalid_argument("The points of a grid must have the same dimension.");
+        }
+        Cell &cell = cells_[key(point)];
+        cell.ids.push_back(id);
+        cell.points.insert(cell.points.end(), point.begin(), point.end());
+        size_++;
+    }
+
+    void GridIndex::remove(const size_t id,
+                           const vector<float> &point) {
+        auto cell = cells_.find(key(point));
+        if (cell == cells_.end()) { return; }
+        vector<size_t> &ids = cell->second.ids;
+        auto it = std::find(ids.begin(), ids.end(), id);
+        if (it == ids.end()) { return; }
+
+        // The last point of the cell takes the place of the removed one
+        const size_t i(it - ids.begin()), last(ids.size() - 1);
+        vector<float> &points = cell->second.points;
+        ids[i] = ids[last];
+        std::copy(points.begin() + last * ndims_, points.end(), points.begin() + i * ndims_);
+        ids.pop_back();
+        points.resize(last * ndims_);
+        if (ids.empty()) { cells_.erase(cell); }
+        size_--;
+    }
+
     void neighbors_from_frame(Neighbors &neighbors_ij,
                               unsigned int frame,
                               vector<float> &ref_point,
@@ -289,10 +639,8 @@ namespace nns {
         const unsigned int num_frames(data.size());
         float cutsquare(cut * cut);
 
-#ifdef _OPENMP
-#pragma omp parallel for default(none) shared(data, cluster, neighbors_ij, cutsquare)
-#endif
-        for (unsigned int i = 0; i < cluster.size(); i++) {
+        // Tasks, such that clusters of the hierarchy are processed in parallel as well
+        Clustering::Utility::parallel_tasks(cluster.size(), 16, [&](const size_t i) {
             unsigned int refpoint(cluster[i]);
 
             // Call calc_neighbors twice to prevent adding
@@ -312,7 +660,7 @@ namespace nns {
             // comprises more than similarity + 1 neighbors
 #pragma omp critical
             if (neighbors_i.size() >= sim + 1) { neighbors_ij[refpoint] = neighbors_i; }
-        }
+        });
     }
 
     void neighbors_from_cluster(Neighbors &neighbors_ij,
@@ -325,10 +673,7 @@ namespace nns {
         const unsigned int num_frames(data.size());
         float cutsquare(cut * cut);
 
-#ifdef _OPENMP
-#pragma omp parallel for default(none) shared(data, cluster, neighbors_ij, second_neighbors_ij, cutsquare)
-#endif
-        for (unsigned int i = 0; i < cluster.size(); i++) {
+        Clustering::Utility::parallel_tasks(cluster.size(), 16, [&](const size_t i) {
             unsigned int refpoint(cluster[i]);
 
             // Call calc_neighbors twice to prevent adding
@@ -352,10 +697,10 @@ namespace nns {
             if (neighbors_i.size() >= sim + 1) {
                 neighbors_ij[refpoint] = neighbors_i;
                 if (second_neighbors_i.size() != 0) {
-                    second_neighbors_ij[i] = second_neighbors_i;
+                    second_neighbors_ij[refpoint] = second_neighbors_i;
                 }
             }
-        }
+        });
     }
 
 } /* end of namespace */
\ No newline at end of file
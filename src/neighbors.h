@@ -26,6 +26,9 @@ SOFTWARE
 #ifndef CLUSTERING_NEIGHBORS_H
 #define CLUSTERING_NEIGHBORS_H
 
+#include <array>
+#include <cmath>
+
 #include "datatypes.h"
 
 using namespace std;
@@ -80,7 +83,242 @@ namespace nns {
                          const float cut,
                          const unsigned int sim);
 
+    // Convert neighbor lists into the CSR format. Points without
+    // a neighbor list obtain an empty row.
+    void graph(Graph &graph,
+               const Neighbors &neighbors_ij);
+
+    // Merge the neighbor lists and the second neighbor lists, i.e.,
+    // within twice the cutoff, into one CSR graph with shell markers.
+    void graph(Graph &graph,
+               const Neighbors &neighbors_ij,
+               const Neighbors &second_neighbors_ij);
+
+    // Euclidean distance of two points
+    float distance(const vector<float> &point1,
+                   const vector<float> &point2);
+
+    // Annotate every edge of `graph` with the distance of its points
+    void distances(Graph &graph,
+                   const vector<vector<float> > &data);
+
+    ////////////// HIERARCHY UTILITY ///////////////
+    // Neighbors of all points of `clusters` within the squared radius
+    // `radiussquare` annotated with their squared distances, i.e., the
+    // graph of a hierarchy level. Other points obtain empty rows.
+    void cluster_graph(Graph &graph,
+                       const vector<vector<unsigned int> > &clusters,
+                       const vector<vector<float> > &data,
+                       const float radiussquare);
+
+    // Restrict a graph of `cluster_graph` to the points of `clusters`
+    // and to a smaller squared radius, i.e., to the next level.
+    void filter_graph(Graph &graph,
+                      const vector<vector<unsigned int> > &clusters,
+                      const float radiussquare);
+
+    // Neighbor lists of all frames in cluster as of `neighbors_from_cluster`
+    // from a graph of `cluster_graph` instead of a scan of the data
+    void neighbors_from_graph(Neighbors &neighbors_ij,
+                              Neighbors &second_neighbors_ij,
+                              const vector<unsigned int> &cluster,
+                              const Graph &graph,
+                              const float cut,
+                              const unsigned int sim,
+                              const bool mutual);
+
+    // Renumber the points of neighbor lists, i.e., the keys and their
+    // neighbors, to 0, 1, ... in ascending order, such that the lists of a
+    // subproblem are dense. The original index of every new point is
+    // stored in `points`. The order of points and lists is kept.
+    void compact(Neighbors &neighbors_ij,
+                 Neighbors &second_neighbors_ij,
+                 vector<unsigned int> &points);
+
     ////////////// MAPPING UTILITY ///////////////
+    // Static kd-tree over the points of `data` for radius queries, e.g.,
+    // of the full data against the reduced data of a mapping. The points
+    // are copied in tree order, such that every leaf is contiguous, and
+    // a node is skipped if its bounding box is out of the radius.
+    class RadiusIndex {
+    public:
+        explicit RadiusIndex(const vector<vector<float> > &data,
+                             const unsigned int leaf_size = 32);
+
+        // Index of the subset `points` of `data` only
+        RadiusIndex(const vector<vector<float> > &data,
+                    const vector<unsigned int> &points,
+                    const unsigned int leaf_size = 32);
+
+        size_t size() const { return indices_.size(); }
+
+        // Calls `visit(point, distancesquare)` for all points within
+        // the squared radius of `ref_point` in the order of the tree
+        template<class Visit>
+        void radius(const vector<float> &ref_point,
+                    const float radiussquare,
+                    Visit visit) const {
+            if (nodes_.empty()) { return; }
+            // Depth of the balanced tree is logarithmic in the points
+            size_t stack[64];
+            size_t top(0);
+            stack[top++] = 0;
+            while (top > 0) {
+                const Node &node = nodes_[stack[--top]];
+                const float *lower = &bounds_[2 * ndims_ * (&node - nodes_.data())];
+                const float *upper = lower + ndims_;
+                float boxdist(0.0);
+                for (unsigned int k = 0; k < ndims_ && boxdist <= radiussquare; ++k) {
+                    const float d(ref_point[k] < lower[k] ? lower[k] - ref_point[k] :
+                                  (ref_point[k] > upper[k] ? ref_point[k] - upper[k] : 0.0f));
+                    boxdist += d * d;
+                }
+                if (boxdist > radiussquare) { continue; }
+
+                if (node.left != 0) {
+                    stack[top++] = node.left + 1;
+                    stack[top++] = node.left;
+                    continue;
+                }
+                for (size_t i = node.begin; i < node.end; ++i) {
+                    // Calculate distance as in calc_neighbors
+                    const float *point = &points_[i * ndims_];
+                    float dist(0.0);
+#pragma omp simd reduction(+:dist)
+                    for (unsigned int k = 0; k < ndims_; ++k) {
+                        float d(ref_point[k] - point[k]);
+                        dist += (d * d);
+                    }
+                    if (dist <= radiussquare) { visit(indices_[i], dist); }
+                }
+            }
+        }
+
+    private:
+        // Points of a node are [begin, end) in tree order. Inner nodes
+        // have the children `left` and `left + 1`, leaves have `left == 0`.
+        struct Node {
+            size_t begin;
+            size_t end;
+            size_t left;
+        };
+
+        unsigned int ndims_;
+        vector<Node> nodes_;
+        // Lower and upper corner of the bounding box of every node
+        vector<float> bounds_;
+        // Original index and coordinates of the points in tree order
+        vector<unsigned int> indices_;
+        vector<float> points_;
+    };
+
+    // Uniform grid of cells of width `width` over the first `grid_dims`
+    // coordinates, into which points are inserted and from which they are
+    // removed one by one, e.g., the sliding window of a stream. A radius
+    // query scans the cells that overlap the radius only and checks the
+    // distance in all dimensions. Empty cells are dropped, thus, the memory
+    // is bounded by the points in the index.
+    class GridIndex {
+    public:
+        explicit GridIndex(const float width,
+                           const unsigned int grid_dims = 3);
+
+        void insert(const size_t id,
+                    const vector<float> &point);
+
+        // Removes `id`, which was inserted at `point`
+        void remove(const size_t id,
+                    const vector<float> &point);
+
+        size_t size() const { return size_; }
+
+        // Calls `visit(id, distancesquare)` for all points within
+        // the squared radius of `ref_point` in no particular order
+        template<class Visit>
+        void radius(const vector<float> &ref_point,
+                    const float radiussquare,
+                    Visit visit) const {
+            if (size_ == 0) { return; }
+            const float radius(std::sqrt(radiussquare));
+            Key lower{}, upper{};
+            double num_cells(1.0);
+            for (unsigned int k = 0; k < dims_; ++k) {
+                lower[k] = coordinate(ref_point[k] - radius);
+                upper[k] = coordinate(ref_point[k] + radius);
+                num_cells *= static_cast<double>(upper[k] - lower[k] + 1);
+            }
+            // A radius of many cells is cheaper to check cell by cell
+            if (num_cells > static_cast<double>(cells_.size())) {
+                for (auto const &cell : cells_)
+                    scan(cell.second, ref_point, radiussquare, visit);
+                return;
+            }
+            Key key(lower);
+            while (true) {
+                auto cell = cells_.find(key);
+                if (cell != cells_.end())
+                    scan(cell->second, ref_point, radiussquare, visit);
+                unsigned int k(0);
+                while (k < dims_ && key[k] == upper[k]) {
+                    key[k] = lower[k];
+                    ++k;
+                }
+                if (k == dims_) { break; }
+                ++key[k];
+            }
+        }
+
+    private:
+        typedef std::array<long, 3> Key;
+
+        struct KeyHash {
+            size_t operator()(const Key &key) const {
+                size_t hash(0);
+                for (auto const &coordinate : key)
+                    hash = hash * 1000003 ^ static_cast<size_t>(coordinate);
+                return hash;
+            }
+        };
+
+        // Ids and coordinates of the points of a cell
+        struct Cell {
+            vector<size_t> ids;
+            vector<float> points;
+        };
+
+        long coordinate(const float value) const {
+            return static_cast<long>(std::floor(value / width_));
+        }
+
+        Key key(const vector<float> &point) const;
+
+        template<class Visit>
+        void scan(const Cell &cell,
+                  const vector<float> &ref_point,
+                  const float radiussquare,
+                  Visit &visit) const {
+            for (size_t i = 0; i < cell.ids.size(); ++i) {
+                // Calculate distance as in calc_neighbors
+                const float *point = &cell.points[i * ndims_];
+                float dist(0.0);
+#pragma omp simd reduction(+:dist)
+                for (unsigned int k = 0; k < ndims_; ++k) {
+                    float d(ref_point[k] - point[k]);
+                    dist += (d * d);
+                }
+                if (dist <= radiussquare) { visit(cell.ids[i], dist); }
+            }
+        }
+
+        const float width_;
+        const unsigned int grid_dims_;
+        // Dimensions of the points and of the grid, known once a point is inserted
+        unsigned int ndims_;
+        unsigned int dims_;
+        size_t size_;
+        std::unordered_map<Key, Cell, KeyHash> cells_;
+    };
+
     // Obtain neighbor list of one frame
     void neighbors_from_frame(Neighbors &neighbors_ij,
                               unsigned int frame,
@@ -23,6 +23,10 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE
 */
 
+#include <cstdio> // std::rename
+#include <cstdint>
+#include <stdexcept>
+
 #include "io.h"
 
 bool fexists(const string &filename) {
@@ -274,6 +278,215 @@ vector<vector<unsigned int>> read_clusters(vector<clstep> &leaves,
     return clusters;
 }
 
+static const char hierarchy_magic[8] = {'C', 'N', 'N', 'T', 'R', 'E', 'E', '1'};
+
+template<class T>
+static void write_value(ofstream &file, const T value) {
+    file.write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+template<class T>
+static bool read_value(ifstream &file, T &value) {
+    return static_cast<bool>(file.read(reinterpret_cast<char *>(&value), sizeof(T)));
+}
+
+void write_hierarchy(ofstream &hfile,
+                     const Hierarchy &tree,
+                     const size_t first_node) {
+    if (hfile.tellp() == 0)
+        hfile.write(hierarchy_magic, sizeof(hierarchy_magic));
+
+    write_value<uint64_t>(hfile, tree.nodes.size() - first_node);
+    for (size_t node = first_node; node < tree.nodes.size(); node++) {
+        write_value<int64_t>(hfile, tree.nodes[node].parent);
+        write_value<uint32_t>(hfile, tree.nodes[node].step.step);
+        write_value<float>(hfile, tree.nodes[node].step.cut);
+        write_value<uint32_t>(hfile, tree.nodes[node].step.sim);
+        write_value<uint64_t>(hfile, tree.nodes[node].size());
+    }
+    for (size_t node = first_node; node < tree.nodes.size(); node++)
+        hfile.write(reinterpret_cast<const char *>(tree.members.data() + tree.nodes[node].begin),
+                    tree.nodes[node].size() * sizeof(unsigned int));
+    hfile.flush();
+}
+
+// Replays the levels that follow in `hfile` into `tree`
+static void read_levels(ifstream &hfile,
+                        Hierarchy &tree,
+                        const string &hfilename) {
+    uint64_t num_nodes;
+    while (read_value(hfile, num_nodes)) {
+        vector<int64_t> parents(num_nodes);
+        vector<clstep> steps(num_nodes);
+        vector<vector<unsigned int> > clusters(num_nodes);
+        bool complete(true);
+        for (uint64_t node = 0; node < num_nodes && complete; node++) {
+            uint32_t step, sim;
+            float cut;
+            uint64_t size;
+            complete = read_value(hfile, parents[node]) && read_value(hfile, step) &&
+                       read_value(hfile, cut) && read_value(hfile, sim) && read_value(hfile, size);
+            steps[node] = clstep(step, cut, sim);
+            clusters[node].resize(complete ? size : 0);
+        }
+        for (uint64_t node = 0; node < num_nodes && complete; node++)
+            complete = static_cast<bool>(hfile.read(reinterpret_cast<char *>(clusters[node].data()),
+                                                    clusters[node].size() * sizeof(unsigned int)));
+        if (!complete) break;
+
+        // Replay the splits, i.e., consecutive nodes of the same parent
+        for (uint64_t first = 0, last = 0; first < num_nodes; first = last) {
+            while (last < num_nodes && parents[last] == parents[first]) last++;
+            vector<vector<unsigned int> > children(std::make_move_iterator(clusters.begin() + first),
+                                                   std::make_move_iterator(clusters.begin() + last));
+            if (parents[first] < 0)
+                tree.add_roots(children, steps[first]);
+            else if (static_cast<uint64_t>(parents[first]) < tree.nodes.size())
+                tree.split(parents[first], children, steps[first]);
+            else
+                throw std::runtime_error("Corrupt hierarchy file: " + hfilename);
+        }
+    }
+}
+
+Hierarchy read_hierarchy(const string &hfilename) {
+    ifstream hfile(hfilename, std::ios::binary);
+    char magic[sizeof(hierarchy_magic)];
+    if (!hfile.read(magic, sizeof(magic)) || !std::equal(magic, magic + sizeof(magic), hierarchy_magic))
+        throw std::runtime_error("Not a hierarchy file: " + hfilename);
+
+    Hierarchy tree;
+    read_levels(hfile, tree, hfilename);
+    return tree;
+}
+
+uint64_t hash_bytes(const void *bytes,
+                    const size_t size,
+                    uint64_t hash) {
+    const auto *byte = static_cast<const unsigned char *>(bytes);
+    for (size_t i = 0; i < size; i++) {
+        hash ^= byte[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+uint64_t data_hash(const vector<vector<float> > &data) {
+    return data_hash(data, data.size());
+}
+
+uint64_t data_hash(const vector<vector<float> > &data,
+                   const size_t num_points) {
+    const uint64_t size(num_points);
+    uint64_t hash(hash_bytes(&size, sizeof(size)));
+    for (size_t point = 0; point < num_points; point++)
+        hash = hash_bytes(data[point].data(), data[point].size() * sizeof(float), hash);
+    return hash;
+}
+
+static const char checkpoint_magic[8] = {'C', 'N', 'N', 'C', 'K', 'P', 'T', '1'};
+
+void write_checkpoint(const string &checkpointfile,
+                      const uint64_t key,
+                      const Hierarchy &tree,
+                      const vector<char> &active,
+                      const clstep &next_step) {
+    const string tmpfile(checkpointfile + ".tmp");
+    {
+        ofstream cfile(tmpfile, std::ios::binary | std::ios::trunc);
+        cfile.write(checkpoint_magic, sizeof(checkpoint_magic));
+        write_value<uint64_t>(cfile, key);
+        write_value<uint32_t>(cfile, next_step.step);
+        write_value<float>(cfile, next_step.cut);
+        write_value<uint32_t>(cfile, next_step.sim);
+        write_value<uint64_t>(cfile, active.size());
+        cfile.write(active.data(), active.size());
+        // The whole tree as one level, which replays in the order of the nodes
+        write_hierarchy(cfile, tree, 0);
+        if (!cfile)
+            throw std::runtime_error("Could not write checkpoint: " + tmpfile);
+    }
+    if (std::rename(tmpfile.c_str(), checkpointfile.c_str()) != 0)
+        throw std::runtime_error("Could not write checkpoint: " + checkpointfile);
+}
+
+bool read_checkpoint(const string &checkpointfile,
+                     const uint64_t key,
+                     Hierarchy &tree,
+                     vector<char> &active,
+                     clstep &next_step) {
+    ifstream cfile(checkpointfile, std::ios::binary);
+    if (!cfile.good()) return false;
+
+    char magic[sizeof(checkpoint_magic)];
+    if (!cfile.read(magic, sizeof(magic)) || !std::equal(magic, magic + sizeof(magic), checkpoint_magic))
+        throw std::runtime_error("Not a checkpoint file: " + checkpointfile);
+    uint64_t file_key, num_active;
+    uint32_t step, sim;
+    float cut;
+    if (!(read_value(cfile, file_key) && read_value(cfile, step) && read_value(cfile, cut) &&
+          read_value(cfile, sim) && read_value(cfile, num_active)))
+        throw std::runtime_error("Corrupt checkpoint file: " + checkpointfile);
+    if (file_key != key)
+        throw std::runtime_error("Checkpoint belongs to other data or parameters: " + checkpointfile);
+
+    vector<char> file_active(num_active);
+    Hierarchy file_tree;
+    if (!cfile.read(file_active.data(), num_active))
+        throw std::runtime_error("Corrupt checkpoint file: " + checkpointfile);
+    read_levels(cfile, file_tree, checkpointfile);
+    if (file_tree.nodes.size() != num_active)
+        throw std::runtime_error("Corrupt checkpoint file: " + checkpointfile);
+
+    tree = std::move(file_tree);
+    active = std::move(file_active);
+    next_step = clstep(step, cut, sim);
+    return true;
+}
+
+static const char components_magic[8] = {'C', 'N', 'N', 'C', 'O', 'M', 'P', '1'};
+
+void write_components(const string &componentfile,
+                      const uint64_t key,
+                      const vector<unsigned int> &components) {
+    const string tmpfile(componentfile + ".tmp");
+    {
+        ofstream cfile(tmpfile, std::ios::binary | std::ios::trunc);
+        cfile.write(components_magic, sizeof(components_magic));
+        write_value<uint64_t>(cfile, key);
+        write_value<uint64_t>(cfile, components.size());
+        cfile.write(reinterpret_cast<const char *>(components.data()), components.size() * sizeof(unsigned int));
+        if (!cfile)
+            throw std::runtime_error("Could not write components: " + tmpfile);
+    }
+    if (std::rename(tmpfile.c_str(), componentfile.c_str()) != 0)
+        throw std::runtime_error("Could not write components: " + componentfile);
+}
+
+bool read_components(const string &componentfile,
+                     uint64_t &key,
+                     vector<unsigned int> &components) {
+    ifstream cfile(componentfile, std::ios::binary);
+    if (!cfile.good()) return false;
+
+    char magic[sizeof(components_magic)];
+    if (!cfile.read(magic, sizeof(magic)) || !std::equal(magic, magic + sizeof(magic), components_magic))
+        throw std::runtime_error("Not a component file: " + componentfile);
+    uint64_t file_key, num_points;
+    if (!(read_value(cfile, file_key) && read_value(cfile, num_points)))
+        throw std::runtime_error("Corrupt component file: " + componentfile);
+    vector<unsigned int> file_components(num_points);
+    if (!cfile.read(reinterpret_cast<char *>(file_components.data()), num_points * sizeof(unsigned int)))
+        throw std::runtime_error("Corrupt component file: " + componentfile);
+    for (unsigned int point = 0; point < num_points; point++)
+        if (file_components[point] > point)
+            throw std::runtime_error("Corrupt component file: " + componentfile);
+
+    key = file_key;
+    components = std::move(file_components);
+    return true;
+}
+
 void write_dtrajs(const string &dtraj_filename, vector<vector<int> > &dtrajs) {
 
     // Accumulate vectors
@@ -283,6 +496,12 @@ void write_dtrajs(const string &dtraj_filename, vector<vector<int> > &dtrajs) {
         shapes_accum.push_back(dtraj.size());
         dtrajs_accum.insert(dtrajs_accum.end(), dtraj.begin(), dtraj.end());
     }
+    write_dtrajs(dtraj_filename, dtrajs_accum, shapes_accum);
+}
+
+void write_dtrajs(const string &dtraj_filename,
+                  const vector<int> &labels,
+                  const vector<unsigned int> &traj_shapes) {
 
     unsigned int n_dims = 1;
 
@@ -290,9 +509,9 @@ void write_dtrajs(const string &dtraj_filename, vector<vector<int> > &dtrajs) {
     std::string name = dtraj_filename.substr(0, lastdot);
     std::string sfilename = name + "-shape.npy";
 
-    const long unsigned shape_clusters[] = {dtrajs_accum.size()};
-    const long unsigned shape_shapes[] = {shapes_accum.size()};
-    npy::SaveArrayAsNumpy<int>(dtraj_filename, false, n_dims, shape_clusters, dtrajs_accum);
-    npy::SaveArrayAsNumpy<unsigned int>(sfilename, false, n_dims, shape_shapes, shapes_accum);
+    const long unsigned shape_clusters[] = {labels.size()};
+    const long unsigned shape_shapes[] = {traj_shapes.size()};
+    npy::SaveArrayAsNumpy<int>(dtraj_filename, false, n_dims, shape_clusters, labels);
+    npy::SaveArrayAsNumpy<unsigned int>(sfilename, false, n_dims, shape_shapes, traj_shapes);
 }
 
@@ -26,8 +26,10 @@ SOFTWARE
 #ifndef CNN_IO_H
 #define CNN_IO_H
 
+#include <cstdint>
 #include <vector>
 #include <string>
+#include <fstream>
 
 #include "external/npy.h"
 
@@ -69,9 +71,70 @@ void write_clusters(const string &cfilename,
 vector<vector<unsigned int>> read_clusters(vector<clstep> &leaves,
                                            const string &cfilename);
 
+// Hierarchy files log the levels of a hierarchical clustering while it
+// proceeds. Every level lists its new nodes with their members, such that
+// reading the file replays the splits into the same tree. An incomplete
+// last level, e.g., of an interrupted run, is ignored.
+void write_hierarchy(ofstream &hfile,
+                     const Hierarchy &tree,
+                     const size_t first_node);
+
+Hierarchy read_hierarchy(const string &hfilename);
+
+// FNV-1a hash of raw bytes, which may continue the hash of other bytes
+uint64_t hash_bytes(const void *bytes,
+                    const size_t size,
+                    uint64_t hash = 14695981039346656037ull);
+
+// Hash of the data points and their order
+uint64_t data_hash(const vector<vector<float> > &data);
+
+// Hash of the first `num_points` data points, e.g., of the data that
+// was clustered before new points were appended
+uint64_t data_hash(const vector<vector<float> > &data,
+                   const size_t num_points);
+
+// Checkpoints hold the tree of a hierarchical clustering after a level,
+// its active branches and the step of the next level, such that the
+// levels continue from there. A checkpoint is replaced as a whole by
+// renaming a temporary file, thus, the last complete one survives an
+// interruption. `key` identifies the run, e.g., by its data hash.
+void write_checkpoint(const string &checkpointfile,
+                      const uint64_t key,
+                      const Hierarchy &tree,
+                      const vector<char> &active,
+                      const clstep &next_step);
+
+// Restores a checkpoint, returns false if there is none and throws
+// if it is corrupt or belongs to a different run than `key`.
+bool read_checkpoint(const string &checkpointfile,
+                     const uint64_t key,
+                     Hierarchy &tree,
+                     vector<char> &active,
+                     clstep &next_step);
+
+// Component files hold the component labels of an incremental
+// clustering, see Clustering::incremental_clustering, such that later
+// runs only add the appended points. `key` identifies the clustered
+// points and parameters and is written as is.
+void write_components(const string &componentfile,
+                      const uint64_t key,
+                      const vector<unsigned int> &components);
+
+// Returns false if there is no component file and throws if it is corrupt
+bool read_components(const string &componentfile,
+                     uint64_t &key,
+                     vector<unsigned int> &components);
+
 void write_dtrajs(const string &dtraj_filename,
                   vector<vector<int> > &dtrajs);
 
+// Writes the labels of the concatenated frames as they are together with
+// the trajectory shapes, which spares the per-trajectory vectors
+void write_dtrajs(const string &dtraj_filename,
+                  const vector<int> &labels,
+                  const vector<unsigned int> &traj_shapes);
+
 template<class T>
 void write_to_npy(const string &filename,
                   const vector<T> &data) {
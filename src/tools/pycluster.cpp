@@ -53,8 +53,11 @@ PYBIND11_MODULE(pycomdensity, m) {
           "\tis the amount of mutual neighbors.\n"
           "Nkeep: int, optional\n"
           "\tis the minimum number of data points that a cluster must contain to be kept (default: 2).\n"
-          "mutual: bool, optional (currently redundant option; False not possible at the moment)\n"
-          "\trequires that the two considered points are mutual neighbors (default: True).\n"
+          "mutual: bool, optional\n"
+          "\trequires that the two considered points are mutual neighbors, otherwise\n"
+          "\tpoints within twice the cutoff are considered as well (default: True).\n"
+          "deterministic: bool, optional\n"
+          "\tgives the same clusters in the same order for any number of threads (default: False).\n"
           "\n"
           "RETURNS\n"
           "-------\n"
@@ -65,7 +68,8 @@ PYBIND11_MODULE(pycomdensity, m) {
           py::arg("cutoff"),
           py::arg("similarity"),
           py::arg("Nkeep") = 2,
-          py::arg("mutual") = true);
+          py::arg("mutual") = true,
+          py::arg("deterministic") = false);
 
     m.def("common_nearest_neighbor",
           &common_nearest_neighbor,
@@ -82,8 +86,11 @@ PYBIND11_MODULE(pycomdensity, m) {
           "\tis the amount of mutual neighbors.\n"
           "Nkeep: int, optional\n"
           "\tis the minimum number of data points that a cluster must contain to be kept (default: 2).\n"
-          "mutual: bool, optional (currently redundant option; False not possible at the moment)\n"
-          "\trequires that the two considered points are mutual neighbors (default: True).\n"
+          "mutual: bool, optional\n"
+          "\trequires that the two considered points are mutual neighbors, otherwise\n"
+          "\tpoints within twice the cutoff are considered as well (default: True).\n"
+          "deterministic: bool, optional\n"
+          "\tgives the same clusters in the same order for any number of threads (default: False).\n"
           "\n"
           "RETURNS\n"
           "-------\n"
@@ -94,7 +101,64 @@ PYBIND11_MODULE(pycomdensity, m) {
           py::arg("cutoff"),
           py::arg("similarity"),
           py::arg("Nkeep") = 2,
-          py::arg("mutual") = true);
+          py::arg("mutual") = true,
+          py::arg("deterministic") = false);
+
+    m.def("sweep_volumescaled_common_nearest_neighbor",
+          &sweep_volumescaled_common_nearest_neighbor,
+          py::return_value_policy::automatic,
+          "This function performs the vs-CNN clustering for several similarities at once.\n"
+          "The shared neighbors of each pair are counted only once and every clustering\n"
+          "is obtained by thresholding them, which equals mutual neighbor clustering.\n"
+          "\n"
+          "Parameters\n"
+          "-----------\n"
+          "data: Iterable[Iterable[Number]]\n"
+          "\tis the data to be clustered.\n"
+          "cutoff: float\n"
+          "\tis the cutoff radius for neighborhood calculation.\n"
+          "similarities: Iterable[int]\n"
+          "\tare the amounts of mutual neighbors.\n"
+          "Nkeep: int, optional\n"
+          "\tis the minimum number of data points that a cluster must contain to be kept (default: 2).\n"
+          "\n"
+          "RETURNS\n"
+          "-------\n"
+          "list(numpy.Array(numpy.Array(float))):\n"
+          "\tThe clusters for each similarity in the given order. (list(np.Array(cluster(frame)))\n"
+          "\n",
+          py::arg("data"),
+          py::arg("cutoff"),
+          py::arg("similarities"),
+          py::arg("Nkeep") = 2);
+
+    m.def("sweep_common_nearest_neighbor",
+          &sweep_common_nearest_neighbor,
+          py::return_value_policy::automatic,
+          "This function performs the CNN clustering for several similarities at once.\n"
+          "The shared neighbors of each pair are counted only once and every clustering\n"
+          "is obtained by thresholding them, which equals mutual neighbor clustering.\n"
+          "\n"
+          "Parameters\n"
+          "-----------\n"
+          "data: Iterable[Iterable[Number]]\n"
+          "\tis the data to be clustered.\n"
+          "cutoff: float\n"
+          "\tis the cutoff radius for neighborhood calculation.\n"
+          "similarities: Iterable[int]\n"
+          "\tare the amounts of mutual neighbors.\n"
+          "Nkeep: int, optional\n"
+          "\tis the minimum number of data points that a cluster must contain to be kept (default: 2).\n"
+          "\n"
+          "RETURNS\n"
+          "-------\n"
+          "list(numpy.Array(numpy.Array(float))):\n"
+          "\tThe clusters for each similarity in the given order. (list(np.Array(cluster(frame)))\n"
+          "\n",
+          py::arg("data"),
+          py::arg("cutoff"),
+          py::arg("similarities"),
+          py::arg("Nkeep") = 2);
 
     m.def("hierarchical_volumescaled_common_nearest_neighbor",
           &hierarchical_volumescaled_common_nearest_neighbor,
@@ -115,8 +179,19 @@ PYBIND11_MODULE(pycomdensity, m) {
           "\tis the minimum number of data points that a cluster must contain to be kept (default: 2).\n"
           "Nsplit: int, optional\n"
           "\tis the maximum number of data points that a cluster must contain to be considered for splitting (default: 4)\n"
-          "mutual: bool, optional (currently redundant option; False not possible at the moment)\n"
-          "\trequires that the two considered points are mutual neighbors (default: True).\n"
+          "mutual: bool, optional\n"
+          "\trequires that the two considered points are mutual neighbors, otherwise\n"
+          "\tpoints within twice the cutoff are considered as well (default: True).\n"
+          "deterministic: bool, optional\n"
+          "\tgives the same clusters in the same order for any number of threads (default: False).\n"
+          "treefile: str, optional\n"
+          "\tis written with the hierarchy tree level by level, see read_hierarchy (default: no file).\n"
+          "fast: bool, optional\n"
+          "\tderives all levels from the neighbors of the first level, which gives the clusters\n"
+          "\tof deterministic=True in less time (default: False).\n"
+          "resume: bool, optional\n"
+          "\tcontinues from the last level checkpointed next to the treefile, if it belongs to the\n"
+          "\tsame data and parameters (default: False).\n"
           "\n"
           "RETURNS\n"
           "-------\n"
@@ -129,7 +204,11 @@ PYBIND11_MODULE(pycomdensity, m) {
           py::arg("delta_free_energy"),
           py::arg("Nkeep") = 2,
           py::arg("Nsplit") = 4,
-          py::arg("mutual") = true);
+          py::arg("mutual") = true,
+          py::arg("deterministic") = false,
+          py::arg("treefile") = "",
+          py::arg("fast") = false,
+          py::arg("resume") = false);
 
     m.def("hierarchical_common_nearest_neighbor",
           &hierarchical_common_nearest_neighbor,
@@ -150,8 +229,19 @@ PYBIND11_MODULE(pycomdensity, m) {
           "\tis the minimum number of data points that a cluster must contain to be kept (default: 2).\n"
           "Nsplit: int, optional\n"
           "\tis the maximum number of data points that a cluster must contain to be considered for splitting (default: 4)\n"
-          "mutual: bool, optional (currently redundant option; False not possible at the moment)\n"
-          "\trequires that the two considered points are mutual neighbors (default: True).\n"
+          "mutual: bool, optional\n"
+          "\trequires that the two considered points are mutual neighbors, otherwise\n"
+          "\tpoints within twice the cutoff are considered as well (default: True).\n"
+          "deterministic: bool, optional\n"
+          "\tgives the same clusters in the same order for any number of threads (default: False).\n"
+          "treefile: str, optional\n"
+          "\tis written with the hierarchy tree level by level, see read_hierarchy (default: no file).\n"
+          "fast: bool, optional\n"
+          "\tderives all levels from the neighbors of the first level, which gives the clusters\n"
+          "\tof deterministic=True in less time (default: False).\n"
+          "resume: bool, optional\n"
+          "\tcontinues from the last level checkpointed next to the treefile, if it belongs to the\n"
+          "\tsame data and parameters (default: False).\n"
           "\n"
           "RETURNS\n"
           "-------\n"
@@ -164,7 +254,77 @@ PYBIND11_MODULE(pycomdensity, m) {
           py::arg("delta_free_energy"),
           py::arg("Nkeep") = 2,
           py::arg("Nsplit") = 4,
-          py::arg("mutual") = true);
+          py::arg("mutual") = true,
+          py::arg("deterministic") = false,
+          py::arg("treefile") = "",
+          py::arg("fast") = false,
+          py::arg("resume") = false);
+
+    m.def("read_hierarchy",
+          &pyhierarchy,
+          py::return_value_policy::automatic,
+          "This function reads the hierarchy tree of a hierarchical clustering.\n"
+          "\n"
+          "Parameters\n"
+          "-----------\n"
+          "filename: str\n"
+          "\tis the treefile of a hierarchical clustering.\n"
+          "\n"
+          "RETURNS\n"
+          "-------\n"
+          "dict(str, numpy.Array):\n"
+          "\tThe tree nodes with their 'parent' (-1 for the initial clusters), 'step', 'cut' and 'sim'.\n"
+          "\tThe members of node i are members[begin[i]:end[i]], those of its children are\n"
+          "\tconsecutive parts at the front of it. 'leaves' are the nodes of the final clusters.\n"
+          "\n",
+          py::arg("filename"));
+
+    py::class_<PyAssigner>(m, "Assigner",
+                           "This class assigns new frames onto existing clusters with low latency, e.g.,\n"
+                           "within an adaptive sampling loop. It is built once from the clustered data and\n"
+                           "keeps its spatial index in memory. A frame is assigned as by the mapping, i.e.,\n"
+                           "onto the cluster that holds the largest fraction of its members as neighbors.\n"
+                           "\n"
+                           "Parameters\n"
+                           "-----------\n"
+                           "data: Iterable[Iterable[Number]]\n"
+                           "\tis the clustered data.\n"
+                           "clusters: Iterable[Iterable[int]]\n"
+                           "\tare the clusters as arrays of data point indices.\n"
+                           "cutoff: float or Iterable[float]\n"
+                           "\tis the cutoff radius of the clustering, or of every cluster, e.g., of the leaves of a hierarchy.\n"
+                           "similarity: int or Iterable[int]\n"
+                           "\tis the amount of mutual neighbors of the clustering, or of every cluster.\n"
+                           "volumescaled: bool, optional\n"
+                           "\tassigns as the vs-CNN instead of the CNN clustering (default: False).\n"
+                           "\n")
+            .def(py::init<vector<vector<float> >, vector<vector<unsigned int> >, const float,
+                         const unsigned int, const bool>(),
+                 py::arg("data"),
+                 py::arg("clusters"),
+                 py::arg("cutoff"),
+                 py::arg("similarity"),
+                 py::arg("volumescaled") = false)
+            .def(py::init<vector<vector<float> >, vector<vector<unsigned int> >, const vector<float> &,
+                         const vector<unsigned int> &, const bool>(),
+                 py::arg("data"),
+                 py::arg("clusters"),
+                 py::arg("cutoff"),
+                 py::arg("similarity"),
+                 py::arg("volumescaled") = false)
+            .def("assign",
+                 &PyAssigner::assign,
+                 "Assigns the frames in parallel.\n"
+                 "\n"
+                 "RETURNS\n"
+                 "-------\n"
+                 "numpy.Array(int):\n"
+                 "\tThe cluster index of every frame or -1 if it is not assigned.\n",
+                 py::arg("frames"))
+            .def("assign_frame",
+                 &PyAssigner::assign_frame,
+                 "Assigns a single frame and returns its cluster index or -1.\n",
+                 py::arg("frame"));
 
 }
 
@@ -28,10 +28,13 @@ SOFTWARE
 #include <pybind11/numpy.h>
 
 #include <vector>
+#include <memory> // std::make_shared
 
 #include <iomanip> // std::setprecision
 
+#include "pywrapper.h"
 #include "utility.h"
+#include "io.h"
 #include "../core.h"
 #include "../clustering.h"
 #include "../vs_cnn.h"
@@ -39,13 +42,14 @@ SOFTWARE
 
 namespace py = pybind11;
 
+template<class Similarity>
 py::array
-pyclustering(Clustering::Core::Similarity similarity,
-             vector<vector<float>> &data,
+pyclustering(vector<vector<float>> &data,
              const float cut,
              const int sim,
              const int Nkeep,
-             const bool mutual) {
+             const bool mutual,
+             const bool deterministic) {
     //checking input
     if (data.size() == 0)
         throw std::invalid_argument("The input data is empty.");
@@ -61,12 +65,12 @@ pyclustering(Clustering::Core::Similarity similarity,
         throw std::invalid_argument("N_keep must be a value between 2 and the size of the data");
 
     vector<vector<unsigned int>> clusters;
-    clusters = Clustering::clustering(similarity,
-                                      data,
-                                      cut,
-                                      sim,
-                                      Nkeep,
-                                      mutual);
+    clusters = Clustering::clustering<Similarity>(data,
+                                                  cut,
+                                                  sim,
+                                                  Nkeep,
+                                                  mutual,
+                                                  deterministic);
 
     // Some Clustering Result printing
     const unsigned int total_frames = data.size();
@@ -104,13 +108,14 @@ volumescaled_common_nearest_neighbor(vector<vector<float>> data,
                                      const float cut,
                                      const int sim,
                                      const int Nkeep,
-                                     const bool mutual) {
-    return pyclustering(Clustering::CommonDensity::similarity,
-                        data,
-                        cut,
-                        sim,
-                        Nkeep,
-                        mutual);
+                                     const bool mutual,
+                                     const bool deterministic) {
+    return pyclustering<Clustering::CommonDensity::Similarity>(data,
+                                                               cut,
+                                                               sim,
+                                                               Nkeep,
+                                                               mutual,
+                                                               deterministic);
 }
 
 pybind11::array
@@ -118,24 +123,96 @@ common_nearest_neighbor(vector<vector<float>> data,
                         float cut,
                         int sim,
                         int Nkeep,
-                        bool mutual) {
-    return pyclustering(Clustering::CommonNearestNeighbor::similarity,
-                        data,
-                        cut,
-                        sim,
-                        Nkeep,
-                        mutual);
+                        bool mutual,
+                        bool deterministic) {
+    return pyclustering<Clustering::CommonNearestNeighbor::Similarity>(data,
+                                                                       cut,
+                                                                       sim,
+                                                                       Nkeep,
+                                                                       mutual,
+                                                                       deterministic);
 }
 
+template<class Similarity>
+pybind11::list
+pysweep(vector<vector<float>> &data,
+        const float cut,
+        const vector<int> &sims,
+        const int Nkeep) {
+    //checking input
+    if (data.size() == 0)
+        throw std::invalid_argument("The input data is empty.");
+    else
+        for (auto point : data)
+            if (point.size() == 0)
+                throw std::invalid_argument("The input data structure has an empty point.");
+    if (cut <= 0)
+        throw std::invalid_argument("Cutoff radius must be larger than 0.");
+    if (sims.empty())
+        throw std::invalid_argument("At least one similarity parameter is required.");
+    for (auto sim : sims)
+        if (sim < 2)
+            throw std::invalid_argument("Similarity parameter must be at least 2.");
+    if (Nkeep < 2 || Nkeep > data.size())
+        throw std::invalid_argument("N_keep must be a value between 2 and the size of the data");
+
+    vector<unsigned int> usims(sims.begin(), sims.end());
+    vector<vector<vector<unsigned int> > > sweep_clusters;
+    sweep_clusters = Clustering::sweep<Similarity>(data,
+                                                   cut,
+                                                   usims,
+                                                   Nkeep);
+
+    // Deep casting - one array of clusters per similarity
+    py::list returnSweep;
+    for (auto &clusters : sweep_clusters) {
+        std::vector<py::array> tmpClusters;
+        for (auto cluster: clusters) {
+            py::array pCluster = py::cast(cluster);
+            tmpClusters.push_back(pCluster);
+        }
+        py::array returnClusters = py::cast(tmpClusters);
+        returnSweep.append(returnClusters);
+    }
+
+    return returnSweep;
+}
+
+pybind11::list
+sweep_volumescaled_common_nearest_neighbor(vector<vector<float>> data,
+                                           const float cut,
+                                           const vector<int> sims,
+                                           const int Nkeep) {
+    return pysweep<Clustering::CommonDensity::Similarity>(data,
+                                                          cut,
+                                                          sims,
+                                                          Nkeep);
+}
+
+pybind11::list
+sweep_common_nearest_neighbor(vector<vector<float>> data,
+                              const float cut,
+                              const vector<int> sims,
+                              const int Nkeep) {
+    return pysweep<Clustering::CommonNearestNeighbor::Similarity>(data,
+                                                                  cut,
+                                                                  sims,
+                                                                  Nkeep);
+}
+
+template<class Similarity>
 pybind11::array
-hierarchical_clustering(Clustering::Core::Similarity similarity,
-                        vector<vector<float>> &data,
+hierarchical_clustering(vector<vector<float>> &data,
                         const float cut,
                         const int sim,
                         const float delta_fe,
                         const unsigned int Nkeep,
                         const unsigned int Nsplit,
-                        const bool mutual) {
+                        const bool mutual,
+                        const bool deterministic,
+                        const std::string &treefile,
+                        const bool fast,
+                        const bool resume) {
     //checking input
     if (data.size() == 0)
         throw std::invalid_argument("The input data is empty.");
@@ -150,26 +227,42 @@ hierarchical_clustering(Clustering::Core::Similarity similarity,
     if (Nkeep < 2 || Nkeep > data.size())
         throw std::invalid_argument("N_keep must be a value between 2 and the size of the data");
 
+    // A checkpoint only resumes with the same initial clusters in the same order
     vector<vector<unsigned int> > clusters;
-    clusters = Clustering::clustering(similarity,
-                                      data,
-                                      cut,
-                                      sim,
-                                      Nkeep,
-                                      mutual);
+    clusters = Clustering::clustering<Similarity>(data,
+                                                  cut,
+                                                  sim,
+                                                  Nkeep,
+                                                  mutual,
+                                                  deterministic || resume);
 
     // Cluster hierarchically
     clstep init_step(0, cut, sim);
+    Hierarchy tree;
+    tree.add_roots(clusters, init_step);
+    if (fast)
+        Clustering::fast_hierarchical_clustering<Similarity>(tree,
+                                                             data,
+                                                             delta_fe,
+                                                             data[0].size(),
+                                                             Nkeep,
+                                                             Nsplit,
+                                                             mutual,
+                                                             treefile,
+                                                             resume);
+    else
+        Clustering::hierarchical_clustering<Similarity>(tree,
+                                                        data,
+                                                        delta_fe,
+                                                        data[0].size(),
+                                                        Nkeep,
+                                                        Nsplit,
+                                                        mutual,
+                                                        deterministic,
+                                                        treefile,
+                                                        resume);
     vector<clstep> leaves;
-    leaves = Clustering::hierarchical_clustering(similarity,
-                                                 clusters,
-                                                 data,
-                                                 init_step,
-                                                 delta_fe,
-                                                 data[0].size(),
-                                                 Nkeep,
-                                                 Nsplit,
-                                                 mutual);
+    clusters = tree.leaf_clusters(leaves);
 
     float total = 0;
     float all = static_cast<float>(data.size());
@@ -204,15 +297,22 @@ hierarchical_volumescaled_common_nearest_neighbor(vector<vector<float> > data,
                                                   const float delta_fe,
                                                   const unsigned int Nkeep,
                                                   const unsigned int Nsplit,
-                                                  const bool mutual) {
-    return hierarchical_clustering(Clustering::CommonDensity::similarity,
-                                   data,
-                                   cut,
-                                   sim,
-                                   delta_fe,
-                                   Nkeep,
-                                   Nsplit,
-                                   mutual);
+                                                  const bool mutual,
+                                                  const bool deterministic,
+                                                  const std::string &treefile,
+                                                  const bool fast,
+                                                  const bool resume) {
+    return hierarchical_clustering<Clustering::CommonDensity::Similarity>(data,
+                                                                          cut,
+                                                                          sim,
+                                                                          delta_fe,
+                                                                          Nkeep,
+                                                                          Nsplit,
+                                                                          mutual,
+                                                                          deterministic,
+                                                                          treefile,
+                                                                          fast,
+                                                                          resume);
 }
 
 pybind11::array
@@ -222,13 +322,125 @@ hierarchical_common_nearest_neighbor(vector<vector<float> > data,
                                      const float delta_fe,
                                      const unsigned int Nkeep,
                                      const unsigned int Nsplit,
-                                     const bool mutual) {
-    return hierarchical_clustering(Clustering::CommonNearestNeighbor::similarity,
-                                   data,
-                                   cut,
-                                   sim,
-                                   delta_fe,
-                                   Nkeep,
-                                   Nsplit,
-                                   mutual);
+                                     const bool mutual,
+                                     const bool deterministic,
+                                     const std::string &treefile,
+                                     const bool fast,
+                                     const bool resume) {
+    return hierarchical_clustering<Clustering::CommonNearestNeighbor::Similarity>(data,
+                                                                                  cut,
+                                                                                  sim,
+                                                                                  delta_fe,
+                                                                                  Nkeep,
+                                                                                  Nsplit,
+                                                                                  mutual,
+                                                                                  deterministic,
+                                                                                  treefile,
+                                                                                  fast,
+                                                                                  resume);
+}
+
+pybind11::dict
+pyhierarchy(const std::string &filename) {
+    if (!fexists(filename))
+        throw std::invalid_argument("The hierarchy file does not exist.");
+    Hierarchy tree = read_hierarchy(filename);
+
+    const size_t num_nodes(tree.nodes.size());
+    py::array_t<long> parents(num_nodes);
+    py::array_t<unsigned int> steps(num_nodes);
+    py::array_t<float> cuts(num_nodes);
+    py::array_t<unsigned int> sims(num_nodes);
+    py::array_t<size_t> begins(num_nodes);
+    py::array_t<size_t> ends(num_nodes);
+    auto parent = parents.mutable_unchecked<1>();
+    auto step = steps.mutable_unchecked<1>();
+    auto cut = cuts.mutable_unchecked<1>();
+    auto sim = sims.mutable_unchecked<1>();
+    auto begin = begins.mutable_unchecked<1>();
+    auto end = ends.mutable_unchecked<1>();
+    for (size_t node = 0; node < num_nodes; node++) {
+        parent(node) = tree.nodes[node].parent;
+        step(node) = tree.nodes[node].step.step;
+        cut(node) = tree.nodes[node].step.cut;
+        sim(node) = tree.nodes[node].step.sim;
+        begin(node) = tree.nodes[node].begin;
+        end(node) = tree.nodes[node].end;
+    }
+
+    py::dict hierarchy;
+    hierarchy["parent"] = parents;
+    hierarchy["step"] = steps;
+    hierarchy["cut"] = cuts;
+    hierarchy["sim"] = sims;
+    hierarchy["begin"] = begins;
+    hierarchy["end"] = ends;
+    hierarchy["members"] = py::array_t<unsigned int>(tree.members.size(), tree.members.data());
+    const vector<size_t> leaves(tree.leaves());
+    hierarchy["leaves"] = py::array_t<size_t>(leaves.size(), leaves.data());
+    return hierarchy;
+}
+
+template<class Similarity>
+void make_assigner(const vector<vector<float> > &data,
+                   const vector<vector<unsigned int> > &clusters,
+                   const vector<clstep> &leaves,
+                   std::function<vector<int>(const vector<vector<float> > &)> &assign_frames,
+                   std::function<int(const vector<float> &)> &assign_frame) {
+    auto assigner = std::make_shared<const Clustering::Assigner<Similarity> >(clusters, data, leaves);
+    assign_frames = [assigner](const vector<vector<float> > &frames) { return assigner->assign(frames); };
+    assign_frame = [assigner](const vector<float> &frame) { return assigner->assign(frame); };
+}
+
+PyAssigner::PyAssigner(vector<vector<float> > data,
+                       vector<vector<unsigned int> > clusters,
+                       const vector<float> &cuts,
+                       const vector<unsigned int> &sims,
+                       const bool volumescaled) :
+        ndims_(data.empty() ? 0 : data[0].size()) {
+    //checking input
+    if (data.size() == 0)
+        throw std::invalid_argument("The input data is empty.");
+    if (cuts.size() != clusters.size() || sims.size() != clusters.size())
+        throw std::invalid_argument("There must be one cutoff and similarity per cluster.");
+    for (auto const &cluster : clusters)
+        for (auto const &point : cluster)
+            if (point >= data.size())
+                throw std::invalid_argument("The clusters contain a point out of the data.");
+    for (auto const &point : data)
+        if (point.size() != data[0].size())
+            throw std::invalid_argument("All data points must have the same dimension.");
+
+    vector<clstep> leaves;
+    for (size_t cluster = 0; cluster < clusters.size(); cluster++)
+        leaves.emplace_back(0, cuts[cluster], sims[cluster]);
+    if (volumescaled)
+        make_assigner<Clustering::CommonDensity::Similarity>(data, clusters, leaves, assign_frames_, assign_frame_);
+    else
+        make_assigner<Clustering::CommonNearestNeighbor::Similarity>(data, clusters, leaves, assign_frames_,
+                                                                     assign_frame_);
+}
+
+PyAssigner::PyAssigner(vector<vector<float> > data,
+                       vector<vector<unsigned int> > clusters,
+                       const float cut,
+                       const unsigned int sim,
+                       const bool volumescaled) :
+        PyAssigner(data, clusters, vector<float>(clusters.size(), cut),
+                   vector<unsigned int>(clusters.size(), sim), volumescaled) {}
+
+py::array_t<int>
+PyAssigner::assign(const vector<vector<float> > &frames) const {
+    for (auto const &frame : frames)
+        if (frame.size() != ndims_)
+            throw std::invalid_argument("The frames must have the dimension of the data.");
+    const vector<int> assigned(assign_frames_(frames));
+    return py::array_t<int>(assigned.size(), assigned.data());
+}
+
+int
+PyAssigner::assign_frame(const vector<float> &frame) const {
+    if (frame.size() != ndims_)
+        throw std::invalid_argument("The frame must have the dimension of the data.");
+    return assign_frame_(frame);
 }
@@ -31,6 +31,8 @@ SOFTWARE
 #include <pybind11/numpy.h>
 
 #include <vector>
+#include <string>
+#include <functional>
 
 using namespace std;
 
@@ -39,14 +41,28 @@ volumescaled_common_nearest_neighbor(vector<vector<float>> data,
                                      const float cut,
                                      const int sim,
                                      const int Nkeep,
-                                     const bool mutual);
+                                     const bool mutual,
+                                     const bool deterministic);
 
 pybind11::array
 common_nearest_neighbor(vector<vector<float>> data,
                         const float cut,
                         const int sim,
                         const int Nkeep,
-                        const bool mutual);
+                        const bool mutual,
+                        const bool deterministic);
+
+pybind11::list
+sweep_volumescaled_common_nearest_neighbor(vector<vector<float>> data,
+                                           const float cut,
+                                           const vector<int> sims,
+                                           const int Nkeep);
+
+pybind11::list
+sweep_common_nearest_neighbor(vector<vector<float>> data,
+                              const float cut,
+                              const vector<int> sims,
+                              const int Nkeep);
 
 pybind11::array
 hierarchical_volumescaled_common_nearest_neighbor(vector<vector<float> > data,
@@ -55,7 +71,11 @@ hierarchical_volumescaled_common_nearest_neighbor(vector<vector<float> > data,
                                                   const float delta_fe,
                                                   const unsigned int Nkeep,
                                                   const unsigned int Nsplit,
-                                                  const bool mutual);
+                                                  const bool mutual,
+                                                  const bool deterministic,
+                                                  const std::string &treefile,
+                                                  const bool fast,
+                                                  const bool resume);
 
 pybind11::array
 hierarchical_common_nearest_neighbor(vector<vector<float> > data,
@@ -64,6 +84,39 @@ hierarchical_common_nearest_neighbor(vector<vector<float> > data,
                                      const float delta_fe,
                                      const unsigned int Nkeep,
                                      const unsigned int Nsplit,
-                                     const bool mutual);
+                                     const bool mutual,
+                                     const bool deterministic,
+                                     const std::string &treefile,
+                                     const bool fast,
+                                     const bool resume);
+
+pybind11::dict
+pyhierarchy(const std::string &filename);
+
+// Online assignment of new frames onto the clusters of the reduced data,
+// see Clustering::Assigner, for either similarity policy
+class PyAssigner {
+public:
+    PyAssigner(vector<vector<float> > data,
+               vector<vector<unsigned int> > clusters,
+               const vector<float> &cuts,
+               const vector<unsigned int> &sims,
+               const bool volumescaled);
+
+    PyAssigner(vector<vector<float> > data,
+               vector<vector<unsigned int> > clusters,
+               const float cut,
+               const unsigned int sim,
+               const bool volumescaled);
+
+    pybind11::array_t<int> assign(const vector<vector<float> > &frames) const;
+
+    int assign_frame(const vector<float> &frame) const;
+
+private:
+    size_t ndims_;
+    std::function<vector<int>(const vector<vector<float> > &)> assign_frames_;
+    std::function<int(const vector<float> &)> assign_frame_;
+};
 
 #endif //PYCLUSTERING_PYWRAPPER_H
\ No newline at end of file
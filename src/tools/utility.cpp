@@ -35,11 +35,19 @@ namespace Clustering {
     namespace Utility {
 
         void sortNclean(vector<vector<unsigned int> > &clusters,
-                        unsigned int Nkeep) {
-            __gnu_parallel::sort(clusters.begin(), clusters.end(),
-                                 [](const vector<unsigned int> &a, const vector<unsigned int> &b) {
-                                     return a.size() > b.size();
-                                 });
+                        unsigned int Nkeep,
+                        const bool deterministic) {
+            if (deterministic)
+                __gnu_parallel::sort(clusters.begin(), clusters.end(),
+                                     [](const vector<unsigned int> &a, const vector<unsigned int> &b) {
+                                         if (a.size() != b.size()) { return a.size() > b.size(); }
+                                         return !a.empty() && (b.empty() || a.front() < b.front());
+                                     });
+            else
+                __gnu_parallel::sort(clusters.begin(), clusters.end(),
+                                     [](const vector<unsigned int> &a, const vector<unsigned int> &b) {
+                                         return a.size() > b.size();
+                                     });
             clusters.erase(remove_if(clusters.begin(), clusters.end(),
                                      [Nkeep](const vector<unsigned int> &cluster) {
                                          return cluster.size() <= Nkeep;
@@ -48,6 +56,28 @@ namespace Clustering {
             clusters.shrink_to_fit();
         }
 
+        DisjointSet::DisjointSet(const unsigned int size) : parents_(size), sizes_(size, 1) {
+            std::iota(parents_.begin(), parents_.end(), 0);
+        }
+
+        unsigned int DisjointSet::find(unsigned int element) {
+            while (parents_[element] != element) {
+                parents_[element] = parents_[parents_[element]];
+                element = parents_[element];
+            }
+            return element;
+        }
+
+        bool DisjointSet::unite(const unsigned int a, const unsigned int b) {
+            unsigned int root_a = find(a);
+            unsigned int root_b = find(b);
+            if (root_a == root_b) { return false; }
+            if (sizes_[root_a] < sizes_[root_b]) { std::swap(root_a, root_b); }
+            parents_[root_b] = root_a;
+            sizes_[root_a] += sizes_[root_b];
+            return true;
+        }
+
         ////////////// HIERARCHICAL CLUSTERING UTILITY ///////////////
         vector<clstep>
         hierarchy(const unsigned int nsteps,
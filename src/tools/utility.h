@@ -33,6 +33,8 @@ SOFTWARE
 #include <vector>
 #include <utility>
 
+#include <omp.h>
+
 #include "../datatypes.h"
 
 using namespace std;
@@ -41,8 +43,81 @@ namespace Clustering {
 
     namespace Utility {
 
+        // Sorts the clusters by decreasing size and removes the ones not
+        // larger than `Nkeep`. If `deterministic`, clusters must have
+        // ascending members and ties are ordered by their first member.
         void sortNclean(vector<vector<unsigned int> > &clusters,
-                        unsigned int Nkeep);
+                        unsigned int Nkeep,
+                        const bool deterministic = false);
+
+        // Union-find structure with path halving and union by size
+        class DisjointSet {
+        public:
+            explicit DisjointSet(const unsigned int size);
+
+            unsigned int find(unsigned int element);
+
+            // Returns false if both elements already share a set
+            bool unite(const unsigned int a, const unsigned int b);
+
+            unsigned int size(const unsigned int element) { return sizes_[find(element)]; }
+
+        private:
+            vector<unsigned int> parents_;
+            vector<unsigned int> sizes_;
+        };
+
+        // Runs `body(i)` for all `i` below `size` as OpenMP tasks of at
+        // least `grainsize` iterations. Inside of a parallel region, e.g.,
+        // in a task of the per-cluster hierarchy work, the tasks join the
+        // enclosing team instead of opening a nested one, such that all
+        // levels share one thread budget. Hence, it must be called by one
+        // thread of a team only, which is given within tasks. With a
+        // budget of one thread, see ThreadBudget, the loop runs inline.
+        template<class Body>
+        void parallel_tasks(size_t size, size_t grainsize, Body body) {
+            if (size == 0) { return; }
+#if defined(_OPENMP) && _OPENMP >= 201511
+            if (omp_get_max_threads() == 1) {
+                for (size_t i = 0; i < size; i++)
+                    body(i);
+            } else if (omp_in_parallel()) {
+#pragma omp taskloop default(shared) grainsize(grainsize)
+                for (size_t i = 0; i < size; i++)
+                    body(i);
+            } else {
+#pragma omp parallel default(none) shared(size, grainsize, body)
+#pragma omp single
+#pragma omp taskloop default(shared) grainsize(grainsize)
+                for (size_t i = 0; i < size; i++)
+                    body(i);
+            }
+#elif defined(_OPENMP)
+            // No taskloop before OpenMP 4.5
+#pragma omp parallel for default(none) shared(size, grainsize, body) schedule(dynamic, grainsize)
+            for (size_t i = 0; i < size; i++)
+                body(i);
+#else
+            for (size_t i = 0; i < size; i++)
+                body(i);
+#endif
+        }
+
+        // Thread budget of the nested work of the calling task, i.e., its
+        // number of threads for parallel regions and taskloops, which is
+        // restored at the end of the scope. Since the budget is an
+        // OpenMP ICV of the task, concurrent tasks keep their own budgets.
+        class ThreadBudget {
+        public:
+            explicit ThreadBudget(const int threads) : previous_(omp_get_max_threads()) {
+                omp_set_num_threads(threads > 0 ? threads : 1);
+            }
+
+            ~ThreadBudget() { omp_set_num_threads(previous_); }
+
+        private:
+            const int previous_;
+        };
 
         ////////////// HIERARCHICAL CLUSTERING UTILITY ///////////////
         // Build a hierarchy plan
@@ -23,9 +23,6 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE
 */
 
-#include "core.h"      // Clustering::Core::intersection
-#include "geometry.h"  // geometry::regularized_intersection_volume
-
 #include "vs_cnn.h"
 
 namespace Clustering {
@@ -33,14 +30,9 @@ namespace Clustering {
     namespace CommonDensity {
 
         float calc_distance(const vector<float> &vec1, const vector<float> &vec2) {
-            const unsigned int ndims(vec1.size());
-            float dist(0.0);
-#pragma omp simd reduction(+:dist)
-            for (unsigned int k = 0; k < ndims; k++) {
-                float d(vec1[k] - vec2[k]);
-                dist += (d * d);
-            }
-            return std::sqrt(dist);
+            // The same distance as on annotated graphs, such that the
+            // per-edge thresholds agree with the pairwise decisions
+            return nns::distance(vec1, vec2);
         }
 
         ////////////// CORE UTILITY ///////////////
@@ -50,18 +42,7 @@ namespace Clustering {
                         const unsigned int point,
                         const float cut,
                         const unsigned int sim) {
-            vector<unsigned int> shared_neighbors;
-            Clustering::Core::intersection(shared_neighbors,
-                                           neighbors_ij.at(refpoint),
-                                           neighbors_ij.at(point));
-            float distance = calc_distance(data[refpoint], data[point]);
-            double ivolume = Geometry::regularized_intersection_volume(distance,
-                                                                       cut,
-                                                                       data[refpoint].size());
-            // plus two because of self-contained points
-            double density = static_cast<double>(shared_neighbors.size() + 2) / ivolume;
-            double simdensity = static_cast<double>(sim); // TODO: Here also plus 2?
-            return (density >= simdensity);
+            return Similarity(data, cut, sim)(neighbors_ij, refpoint, point);
         }
 
     } // end namespace CommonDensity
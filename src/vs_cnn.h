@@ -26,9 +26,18 @@ SOFTWARE
 #ifndef CNN_CLUSTERING_COMMONDENSITY_H
 #define CNN_CLUSTERING_COMMONDENSITY_H
 
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
 #include <vector>
 
 #include "neighbors.h"
+#include "core.h"      // Clustering::Core::intersection
+#include "geometry.h"  // Geometry::regularized_intersection_volume
 
 using namespace std;
 
@@ -38,6 +47,125 @@ namespace Clustering {
 
         float calc_distance(const vector<float> &vec1, const vector<float> &vec2);
 
+        // SIMILARITY POLICY
+        // Two points are similar if the density of their shared
+        // neighbors within the intersection volume of their
+        // hyperspheres is at least `sim`. The policy keeps the
+        // data and the dimensionality of the run. Decisions are taken
+        // on the tabulated volumes whenever the bounds of the table
+        // suffice and otherwise on the exact volume, so they equal
+        // those of `score`.
+        class Similarity {
+        public:
+            Similarity(const vector<vector<float> > &data,
+                       const float cut,
+                       const unsigned int sim) :
+                    data_(data),
+                    cut_(cut),
+                    sim_(sim),
+                    ndims_(data.empty() ? 0 : data[0].size()),
+                    volumes_(cut > 0.0f ? Geometry::IntersectionVolumeTable::shared(cut, ndims_) : nullptr),
+                    thresholds_(std::make_shared<Thresholds>()) {}
+
+            // The threshold grows with the intersection volume
+            static constexpr bool distance_dependent = true;
+
+            bool operator()(const Neighbors &neighbors_ij,
+                            const unsigned int refpoint,
+                            const unsigned int point) const {
+                vector<unsigned int> shared_neighbors;
+                Clustering::Core::intersection(shared_neighbors,
+                                               neighbors_ij.at(refpoint),
+                                               neighbors_ij.at(point));
+                return (*this)(shared_neighbors.size(), refpoint, point);
+            }
+
+            // Decision for an already known number of shared neighbors
+            bool operator()(const size_t shared,
+                            const unsigned int refpoint,
+                            const unsigned int point) const {
+                return similar(shared, calc_distance(data_[refpoint], data_[point]));
+            }
+
+            // Smallest number of shared neighbors at which two points
+            // at `distance` are similar. The intersection volume shrinks
+            // with the distance, hence, the threshold is a step function
+            // of at most `sim` steps whose positions are found once.
+            unsigned int threshold(const float distance) const {
+                std::call_once(thresholds_->once, [this]() { tabulate_thresholds(); });
+                const vector<float> &steps = thresholds_->distances;
+                return std::lower_bound(steps.begin(), steps.end(), distance, std::greater<float>()) - steps.begin();
+            }
+
+            // Quantity that is compared to `sim`, i.e., the shared neighbor density
+            double score(const size_t shared,
+                         const unsigned int refpoint,
+                         const unsigned int point) const {
+                float distance = calc_distance(data_[refpoint], data_[point]);
+                double ivolume = Geometry::regularized_intersection_volume(distance, cut_, ndims_);
+                // plus two because of self-contained points
+                return static_cast<double>(shared + 2) / ivolume;
+            }
+
+            // Criterion of a frame being mapped onto a cluster
+            // given the number of its neighbors in the cluster.
+            bool mapping(const size_t shared) const {
+                return (shared >= sim_);
+            }
+
+        private:
+            bool similar(const size_t shared,
+                         const float distance) const {
+                double simdensity = static_cast<double>(sim_); // TODO: Here also plus 2?
+                // plus two because of self-contained points
+                double count = static_cast<double>(shared + 2);
+                double lower, upper;
+                if (volumes_ && volumes_->bounds(distance, lower, upper)) {
+                    if (count / upper >= simdensity) return true;
+                    if (count / lower < simdensity) return false;
+                }
+                return (count / Geometry::regularized_intersection_volume(distance, cut_, ndims_) >= simdensity);
+            }
+
+            // Smallest distance at which `shared` neighbors suffice for
+            // every `shared` below `sim`, found by bisection over floats
+            void tabulate_thresholds() const {
+                vector<float> &steps = thresholds_->distances;
+                steps.assign(sim_, std::numeric_limits<float>::infinity());
+                const float far = 2.0f * cut_;
+                for (unsigned int shared = 0; shared < sim_; shared++) {
+                    if (similar(shared, 0.0f)) {
+                        steps[shared] = 0.0f;
+                        continue;
+                    }
+                    if (!similar(shared, far)) continue;
+                    // Non-negative floats are ordered like their bit patterns
+                    uint32_t lower = 0, upper;
+                    std::memcpy(&upper, &far, sizeof(float));
+                    while (upper - lower > 1) {
+                        uint32_t middle = lower + (upper - lower) / 2;
+                        float distance;
+                        std::memcpy(&distance, &middle, sizeof(float));
+                        if (similar(shared, distance)) upper = middle;
+                        else lower = middle;
+                    }
+                    std::memcpy(&steps[shared], &upper, sizeof(float));
+                }
+            }
+
+            struct Thresholds {
+                std::once_flag once;
+                vector<float> distances;
+            };
+
+            const vector<vector<float> > &data_;
+            const float cut_;
+            const unsigned int sim_;
+            const unsigned int ndims_;
+            std::shared_ptr<const Geometry::IntersectionVolumeTable> volumes_;
+            std::shared_ptr<Thresholds> thresholds_;
+        };
+
         ////////////// CORE UTILITY ///////////////
         bool similarity(vector<vector<float> > &data,
                         const Neighbors &neighbors_ij,
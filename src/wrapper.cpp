@@ -53,7 +53,9 @@ namespace Clustering {
             const auto cut = args.flag<float>("-cut");
             const auto sim = args.flag<unsigned int>("-sim");
             const auto Nkeep = args.flag<int>("-Nkeep");
-            const auto mutual = args.flag<bool>("mutual");
+            const auto mutual = args.flag<bool>("mutual") && !args.flag<bool>("-nonmutual");
+            const auto deterministic = args.flag<bool>("--deterministic");
+            const auto incremental = args.flag<bool>("--incremental");
 
             // Obtain data
             vector<vector<float>> data;
@@ -64,31 +66,86 @@ namespace Clustering {
             total_frames = get_tICs(data, frames, shapes, traj_shapes, datafile, ntrajs, ndims, slice);
             std::cout << "TOTAL # FRAMES " << total_frames << std::endl;
 
-            try {
-                clusters = read_clusters(leaves, clusterfile);
-            } catch (...) {
-                // Obtain neighbor lists
-                Neighbors neighbor_lists;
-                Neighbors second_neighbor_lists;
-                nns::neighbors(neighbor_lists, data, cut, 0);
-
-                // Obtain clusters
-                Core::simptr similarity;
-                similarity = args.flag<bool>("-CNN") ? CommonNearestNeighbor::similarity : CommonDensity::similarity;
-                clusters = Clustering::Core::algorithm(similarity,
-                                                       data,
-                                                       neighbor_lists,
-                                                       second_neighbor_lists,
-                                                       cut,
-                                                       sim,
-                                                       Nkeep,
-                                                       mutual);
-                leaves.resize(clusters.size(), clstep(0, cut, sim));
+            if (incremental) {
+                if (!mutual)
+                    throw std::invalid_argument("The incremental clustering requires mutual neighbors.");
+                // The components of the frames of a previous run are kept next to
+                // the cluster file. If the data starts with the same frames and the
+                // parameters are the same, only the appended frames are clustered.
+                const std::string componentfile = clusterfile.substr(0, clusterfile.find_last_of('.')) +
+                                                  "-components.bin";
+                const bool cnn(args.flag<bool>("-CNN"));
+                auto run_key = [&](const size_t num_points) {
+                    const float parameters[] = {cut, static_cast<float>(sim), static_cast<float>(cnn)};
+                    return hash_bytes(parameters, sizeof(parameters), data_hash(data, num_points));
+                };
+                vector<unsigned int> components;
+                uint64_t key(0);
+                if (read_components(componentfile, key, components) &&
+                    (components.size() > data.size() || key != run_key(components.size()))) {
+                    std::cout << "Components of other data or parameters, all frames are clustered" << std::endl;
+                    components.clear();
+                }
+                std::cout << "INCREMENTAL CLUSTERING OF " << data.size() - components.size() << " NEW FRAMES"
+                          << std::endl;
+
+                if (cnn)
+                    clusters = Clustering::incremental_clustering<CommonNearestNeighbor::Similarity>(components,
+                                                                                                     data,
+                                                                                                     cut,
+                                                                                                     sim,
+                                                                                                     Nkeep);
+                else
+                    clusters = Clustering::incremental_clustering<CommonDensity::Similarity>(components,
+                                                                                             data,
+                                                                                             cut,
+                                                                                             sim,
+                                                                                             Nkeep);
+                write_components(componentfile, run_key(data.size()), components);
+                leaves.assign(clusters.size(), clstep(0, cut, sim));
 
                 // Write to file
                 std::string ofile = clusterfile;
                 if (fexists(ofile)) { ofile = backup_file(clusterfile); }
                 write_clusters(ofile, clusters, leaves);
+            } else {
+                try {
+                    clusters = read_clusters(leaves, clusterfile);
+                } catch (...) {
+                    // Obtain neighbor lists
+                    Neighbors neighbor_lists;
+                    Neighbors second_neighbor_lists;
+                    if (mutual)
+                        nns::neighbors(neighbor_lists, data, cut, 0);
+                    else
+                        nns::neighbors(neighbor_lists, second_neighbor_lists, data, cut, 0, mutual);
+
+                    // Obtain clusters
+                    if (args.flag<bool>("-CNN"))
+                        clusters = Clustering::Core::algorithm<CommonNearestNeighbor::Similarity>(data,
+                                                                                                  neighbor_lists,
+                                                                                                  second_neighbor_lists,
+                                                                                                  cut,
+                                                                                                  sim,
+                                                                                                  Nkeep,
+                                                                                                  mutual,
+                                                                                                  deterministic);
+                    else
+                        clusters = Clustering::Core::algorithm<CommonDensity::Similarity>(data,
+                                                                                          neighbor_lists,
+                                                                                          second_neighbor_lists,
+                                                                                          cut,
+                                                                                          sim,
+                                                                                          Nkeep,
+                                                                                          mutual,
+                                                                                          deterministic);
+                    leaves.resize(clusters.size(), clstep(0, cut, sim));
+
+                    // Write to file
+                    std::string ofile = clusterfile;
+                    if (fexists(ofile)) { ofile = backup_file(clusterfile); }
+                    write_clusters(ofile, clusters, leaves);
+                }
             }
 
             // Some debug printing
@@ -121,7 +178,8 @@ namespace Clustering {
             const auto nsteps = args.flag<unsigned int>("-nsteps");
             const auto Nkeep = args.flag<int>("-Nkeep");
             const auto relmax = args.flag<float>("-relmax");
-            const auto mutual = args.flag<bool>("mutual");
+            const auto mutual = args.flag<bool>("mutual") && !args.flag<bool>("-nonmutual");
+            const auto deterministic = args.flag<bool>("--deterministic");
 
             // Obtain tICs
             vector<vector<float>> tICs;
@@ -141,21 +199,32 @@ namespace Clustering {
                 // Obtain neighbor lists
                 Neighbors neighbor_lists;
                 Neighbors second_neighbor_lists;
-                nns::neighbors(neighbor_lists, tICs, clstep.cut, 0);
+                if (mutual)
+                    nns::neighbors(neighbor_lists, tICs, clstep.cut, 0);
+                else
+                    nns::neighbors(neighbor_lists, second_neighbor_lists, tICs, clstep.cut, 0, mutual);
                 if (neighbor_lists.size() < 2) continue;
 
                 // Obtain clusters
-                Core::simptr similarity;
-                similarity = args.flag<bool>("-CNN") ? CommonNearestNeighbor::similarity : CommonDensity::similarity;
                 vector<vector<unsigned int> > scan_clusters;
-                scan_clusters = Clustering::Core::algorithm(similarity,
-                                                            tICs,
-                                                            neighbor_lists,
-                                                            second_neighbor_lists,
-                                                            clstep.cut,
-                                                            clstep.sim,
-                                                            Nkeep,
-                                                            mutual);
+                if (args.flag<bool>("-CNN"))
+                    scan_clusters = Clustering::Core::algorithm<CommonNearestNeighbor::Similarity>(tICs,
+                                                                                                   neighbor_lists,
+                                                                                                   second_neighbor_lists,
+                                                                                                   clstep.cut,
+                                                                                                   clstep.sim,
+                                                                                                   Nkeep,
+                                                                                                   mutual,
+                                                                                                   deterministic);
+                else
+                    scan_clusters = Clustering::Core::algorithm<CommonDensity::Similarity>(tICs,
+                                                                                           neighbor_lists,
+                                                                                           second_neighbor_lists,
+                                                                                           clstep.cut,
+                                                                                           clstep.sim,
+                                                                                           Nkeep,
+                                                                                           mutual,
+                                                                                           deterministic);
                 // Some debug printing
                 float total = 0;
                 auto all = static_cast<float>(total_frames);
@@ -186,6 +255,72 @@ namespace Clustering {
             write_clusters(ofile, clusters, leaves);
         }
 
+        void sweep(vector<vector<unsigned int> > &clusters,
+                   vector<clstep> &leaves,
+                   ArgParse &args) {
+            // Input arguments from terminal flags
+            const auto datafile = args.flag<std::string>("-dfile");
+            const auto clusterfile = args.flag<std::string>("-cfile");
+            const auto ntrajs = args.flag<unsigned int>("-ntrajs");
+            const auto ndims = args.flag<unsigned int>("-ndims");
+            const auto slice = args.flag<unsigned int>("-slice");
+            const auto cut = args.flag<float>("-cut");
+            const auto sim = args.flag<unsigned int>("-sim");
+            const auto delta_sim = args.flag<unsigned int>("-dsim");
+            const auto nsteps = args.flag<unsigned int>("-nsteps");
+            const auto Nkeep = args.flag<int>("-Nkeep");
+
+            // Obtain tICs
+            vector<vector<float>> tICs;
+            vector<unsigned int> shapes;
+            map<unsigned int, unsigned int> frames;
+            vector<unsigned int> traj_shapes(3);
+            unsigned int total_frames = 0;
+            total_frames = get_tICs(tICs, frames, shapes, traj_shapes, datafile, ntrajs, ndims, slice);
+            std::cout << "TOTAL # FRAMES " << total_frames << std::endl;
+
+            // Get a plan with fixed cutoff
+            vector<clstep> plan;
+            plan = Clustering::Utility::hierarchy(nsteps, cut, 0.0f, sim, delta_sim);
+            vector<unsigned int> sims;
+            for (auto &step : plan)
+                sims.push_back(step.sim);
+
+            // Obtain clusters of all steps from one pass over the neighbor lists
+            vector<vector<vector<unsigned int> > > sweep_clusters;
+            if (args.flag<bool>("-CNN"))
+                sweep_clusters = Clustering::sweep<CommonNearestNeighbor::Similarity>(tICs, cut, sims, Nkeep);
+            else
+                sweep_clusters = Clustering::sweep<CommonDensity::Similarity>(tICs, cut, sims, Nkeep);
+
+            const size_t lastdot = clusterfile.find_last_of('.');
+            for (size_t i = 0; i < plan.size(); i++) {
+                // Some debug printing
+                float total = 0;
+                auto all = static_cast<float>(total_frames);
+                cout << " CLUSTERING RESULTS " << endl;
+                cout << "Cut: " << plan[i].cut << "\tSim: " << plan[i].sim << endl;
+                cout << std::setprecision(2);
+                for (size_t idx = 0; idx < sweep_clusters[i].size(); idx++) {
+                    auto clsize = static_cast<float>(sweep_clusters[i][idx].size());
+                    cout << idx << "\t" << sweep_clusters[i][idx].size() << "\t" << 100.0f * clsize / all << "%" << endl;
+                    total += clsize;
+                }
+                cout << "Remaining noise is : " << 100.0f * (1.0 - total / all) << "%\n" << endl;
+
+                // Write to file, e.g., clusters-sim10.npy
+                vector<clstep> sweep_leaves(sweep_clusters[i].size(), plan[i]);
+                std::string ofile = clusterfile.substr(0, lastdot) + "-sim" + std::to_string(plan[i].sim) +
+                                    clusterfile.substr(lastdot);
+                if (fexists(ofile)) { ofile = backup_file(ofile); }
+                write_clusters(ofile, sweep_clusters[i], sweep_leaves);
+            }
+
+            // The most similar clustering is passed on
+            clusters = sweep_clusters.back();
+            leaves.assign(clusters.size(), plan.back());
+        }
+
         void hierarchical_clustering(vector<vector<unsigned int> > &clusters,
                                      vector<clstep> &leaves,
                                      ArgParse &args) {
@@ -201,7 +336,10 @@ namespace Clustering {
             const auto delta_fe = args.flag<float>("-dfe");
             const auto Nkeep = args.flag<int>("-Nkeep");
             const auto Nsplit = args.flag<int>("-Nsplit");
-            const auto mutual = args.flag<bool>("mutual");
+            const auto mutual = args.flag<bool>("mutual") && !args.flag<bool>("-nonmutual");
+            const auto deterministic = args.flag<bool>("--deterministic");
+            const auto fast = args.flag<bool>("--fast");
+            const auto resume = args.flag<bool>("--resume");
 
             // Obtain tICs
             vector<vector<float>> tICs;
@@ -215,23 +353,58 @@ namespace Clustering {
             try {
                 clusters = read_clusters(leaves, hierarchicfile);
             } catch (...) {
-                // Cluster hierarchically
-                Core::simptr similarity;
-                similarity = args.flag<bool>("-CNN") ? CommonNearestNeighbor::similarity : CommonDensity::similarity;
+                // Cluster hierarchically, the tree is written and checkpointed level by level
+                std::string ofile = hierarchicfile;
+                if (fexists(ofile)) { ofile = backup_file(hierarchicfile); }
+                const std::string treefile = ofile.substr(0, ofile.find_last_of('.')) + "-tree.bin";
                 clstep init_step(0, cut, sim);
-                leaves = Clustering::hierarchical_clustering(similarity,
-                                                             clusters,
-                                                             tICs,
-                                                             init_step,
-                                                             delta_fe,
-                                                             traj_shapes[2],
-                                                             Nkeep,
-                                                             Nsplit,
-                                                             mutual);
+                Hierarchy tree;
+                tree.add_roots(clusters, init_step);
+                if (args.flag<bool>("-CNN") && fast)
+                    Clustering::fast_hierarchical_clustering<CommonNearestNeighbor::Similarity>(tree,
+                                                                                                tICs,
+                                                                                                delta_fe,
+                                                                                                traj_shapes[2],
+                                                                                                Nkeep,
+                                                                                                Nsplit,
+                                                                                                mutual,
+                                                                                                treefile,
+                                                                                                resume);
+                else if (args.flag<bool>("-CNN"))
+                    Clustering::hierarchical_clustering<CommonNearestNeighbor::Similarity>(tree,
+                                                                                           tICs,
+                                                                                           delta_fe,
+                                                                                           traj_shapes[2],
+                                                                                           Nkeep,
+                                                                                           Nsplit,
+                                                                                           mutual,
+                                                                                           deterministic,
+                                                                                           treefile,
+                                                                                           resume);
+                else if (fast)
+                    Clustering::fast_hierarchical_clustering<CommonDensity::Similarity>(tree,
+                                                                                        tICs,
+                                                                                        delta_fe,
+                                                                                        traj_shapes[2],
+                                                                                        Nkeep,
+                                                                                        Nsplit,
+                                                                                        mutual,
+                                                                                        treefile,
+                                                                                        resume);
+                else
+                    Clustering::hierarchical_clustering<CommonDensity::Similarity>(tree,
+                                                                                   tICs,
+                                                                                   delta_fe,
+                                                                                   traj_shapes[2],
+                                                                                   Nkeep,
+                                                                                   Nsplit,
+                                                                                   mutual,
+                                                                                   deterministic,
+                                                                                   treefile,
+                                                                                   resume);
+                clusters = tree.leaf_clusters(leaves);
 
                 // Write to file
-                std::string ofile = hierarchicfile;
-                if (fexists(ofile)) { ofile = backup_file(hierarchicfile); }
                 write_clusters(ofile, clusters, leaves);
             }
 
@@ -260,6 +433,8 @@ namespace Clustering {
             unsigned int ntrajs = args.flag<unsigned int>("-ntrajs");
             unsigned int ndims = args.flag<unsigned int>("-ndims");
             unsigned int slice = args.flag<unsigned int>("-slice");
+            std::string hierarchicfile = args.flag<std::string>("-hfile");
+            bool descend = args.flag<bool>("--descend");
 
             // Obtain full tICs
             vector<vector<float>> full_tICs;
@@ -282,8 +457,24 @@ namespace Clustering {
                 get_tICs(reduced_tICs, reduced_frames, reduced_shapes, reduced_traj_shapes, datafile, ntrajs, ndims,
                          slice);
 
-                // Map frames to existing clusters
-                Clustering::cluster_mapping(clusters, full_tICs, reduced_tICs, reduced_frames, leaves, slice);
+                // Map frames to existing clusters, or to the leaves of the
+                // hierarchy tree of the hierarchical clustering
+                const std::string treefile = hierarchicfile.substr(0, hierarchicfile.find_last_of('.')) + "-tree.bin";
+                if (descend && fexists(treefile)) {
+                    const Hierarchy tree = read_hierarchy(treefile);
+                    if (args.flag<bool>("-CNN"))
+                        clusters = Clustering::hierarchy_mapping<CommonNearestNeighbor::Similarity>(
+                                tree, full_tICs, reduced_tICs, reduced_frames, leaves);
+                    else
+                        clusters = Clustering::hierarchy_mapping<CommonDensity::Similarity>(
+                                tree, full_tICs, reduced_tICs, reduced_frames, leaves);
+                } else if (args.flag<bool>("-CNN")) {
+                    Clustering::cluster_mapping<CommonNearestNeighbor::Similarity>(clusters, full_tICs, reduced_tICs,
+                                                                                   reduced_frames, leaves);
+                } else {
+                    Clustering::cluster_mapping<CommonDensity::Similarity>(clusters, full_tICs, reduced_tICs,
+                                                                           reduced_frames, leaves);
+                }
 
                 // Write to file
                 std::string ofile = mappingfile;
@@ -328,12 +519,13 @@ namespace Clustering {
             vector<unsigned int> traj_shapes(3);
             get_tICs(tICs, frames, shapes, traj_shapes, datafile, ntrajs, ndims, final_slice);
 
-            // Obtain the discrete trajectories
-            vector<vector<int> > dtrajs;
-            dtrajs = Clustering::Discretization::dtrajs(clusters, shapes);
+            // Obtain the labels of the concatenated frames, which are
+            // the concatenated discrete trajectories
+            const size_t num_frames = Clustering::Discretization::offsets(shapes).back();
+            vector<int> labels = Clustering::Discretization::labels(clusters, num_frames);
 
             // Write to file
-            write_dtrajs(dtrajfile, dtrajs);
+            write_dtrajs(dtrajfile, labels, shapes);
         }
 
     }
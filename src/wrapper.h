@@ -59,6 +59,11 @@ namespace Clustering {
              vector<clstep> &leaves,
              ArgParse &args);
 
+        void
+        sweep(vector<vector<unsigned int> > &clusters,
+              vector<clstep> &leaves,
+              ArgParse &args);
+
         void
         hierarchical_clustering(vector<vector<unsigned int> > &clusters,
                                 vector<clstep> &leaves,
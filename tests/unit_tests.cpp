@@ -11,6 +11,11 @@ namespace utf = boost::unit_test;
 namespace tt = boost::test_tools;
 
 #include <vector>
+#include <map>
+#include <numeric>
+#include <cmath>
+#include <cstdio>
+#include <omp.h>
 #include "../src/datatypes.h"
 #include "../src/neighbors.h"
 
@@ -19,6 +24,9 @@ namespace tt = boost::test_tools;
 #include "../src/cnn.h"
 #include "../src/vs_cnn.h"
 #include "../src/geometry.h"
+#include "../src/discretization.h"
+#include "../src/tools/utility.h"
+#include "../src/tools/io.h"
 
 struct dataFixture {
     dataFixture() {
@@ -149,6 +157,146 @@ BOOST_FIXTURE_TEST_SUITE(NeighborsTestSuite, dataFixture)
         }
     }
 
+    BOOST_AUTO_TEST_CASE(graph) {
+
+        Graph graph;
+        nns::graph(graph, mdm_neighbor_lists);
+
+        BOOST_CHECK_EQUAL(graph.num_points(), mdm.size());
+        for (unsigned int point = 0; point < graph.num_points(); point++) {
+            if (mdm_neighbor_lists.count(point) == 0) {
+                BOOST_CHECK_EQUAL(graph.degree(point), 0);
+                continue;
+            }
+            const vector<unsigned int> &list = mdm_neighbor_lists[point];
+            BOOST_CHECK_EQUAL(graph.degree(point), list.size());
+            for (size_t i = 0; i < list.size(); i++)
+                BOOST_CHECK_EQUAL(graph.edge(point, list[i]), graph.offsets[point] + i);
+        }
+        BOOST_CHECK_EQUAL(graph.edge(0, 15), graph.edges.size());
+    }
+
+    BOOST_AUTO_TEST_CASE(shell_graph) {
+
+        Neighbors neighbors_ij;
+        Neighbors second_neighbors_ij;
+        nns::neighbors(neighbors_ij, second_neighbors_ij, mdm, fixed_cut, 0, false);
+
+        Graph graph;
+        nns::graph(graph, neighbors_ij, second_neighbors_ij);
+
+        // Each row is sorted and marks the neighbors outside of the cutoff
+        for (unsigned int point = 0; point < graph.num_points(); point++) {
+            BOOST_CHECK(std::is_sorted(graph.edges.begin() + graph.offsets[point],
+                                       graph.edges.begin() + graph.offsets[point + 1]));
+            size_t first_shell = 0;
+            for (size_t edge = graph.offsets[point]; edge < graph.offsets[point + 1]; edge++)
+                if (!graph.second_shell(edge))
+                    first_shell++;
+            BOOST_CHECK_EQUAL(first_shell, neighbors_ij.count(point) ? neighbors_ij[point].size() : 0);
+            BOOST_CHECK_EQUAL(graph.degree(point) - first_shell,
+                              second_neighbors_ij.count(point) ? second_neighbors_ij[point].size() : 0);
+        }
+    }
+
+    BOOST_AUTO_TEST_CASE(level_graph) {
+
+        // Two hierarchy levels where the second one keeps a part of the points
+        vector<vector<unsigned int> > clusters(1);
+        for (unsigned int point = 0; point < mdm.size(); point++)
+            clusters[0].push_back(point);
+        vector<vector<unsigned int> > next_clusters(1, vector<unsigned int>(clusters[0].begin() + 3,
+                                                                            clusters[0].end() - 2));
+
+        for (bool mutual : {true, false}) {
+            const float cut = 2.0f * fixed_cut;
+            const float next_cut = fixed_cut;
+            const float factor = mutual ? 1.0f : 4.0f;
+
+            Graph graph;
+            nns::cluster_graph(graph, clusters, mdm, factor * cut * cut);
+            for (auto const &level : {std::make_pair(cut, clusters), std::make_pair(next_cut, next_clusters)}) {
+                if (level.first != cut)
+                    nns::filter_graph(graph, level.second, factor * level.first * level.first);
+
+                // Same lists as from a scan of the data
+                Neighbors neighbors_ij, second_neighbors_ij;
+                Neighbors scanned_ij, scanned_second_ij;
+                vector<unsigned int> cluster(level.second[0]);
+                nns::neighbors_from_graph(neighbors_ij, second_neighbors_ij, cluster, graph,
+                                          level.first, 0, mutual);
+                if (mutual)
+                    nns::neighbors_from_cluster(scanned_ij, cluster, mdm, level.first, 0);
+                else
+                    nns::neighbors_from_cluster(scanned_ij, scanned_second_ij, cluster, mdm,
+                                                level.first, 0, mutual);
+                BOOST_CHECK(neighbors_ij == scanned_ij);
+                BOOST_CHECK(second_neighbors_ij == scanned_second_ij);
+            }
+        }
+    }
+
+    BOOST_AUTO_TEST_CASE(compact) {
+
+        Neighbors neighbors_ij = {{4, {7, 9}}, {7, {4, 12}}, {9, {4}}};
+        Neighbors second_neighbors_ij = {{4, {20}}};
+        vector<unsigned int> points;
+        nns::compact(neighbors_ij, second_neighbors_ij, points);
+
+        // Dense and order preserving renumbering
+        BOOST_CHECK(points == vector<unsigned int>({4, 7, 9, 12, 20}));
+        BOOST_CHECK(neighbors_ij == Neighbors({{0, {1, 2}}, {1, {0, 3}}, {2, {0}}}));
+        BOOST_CHECK(second_neighbors_ij == Neighbors({{0, {4}}}));
+    }
+
+    BOOST_AUTO_TEST_CASE(radius_index) {
+
+        // Radius queries of the index equal a scan of the data
+        const nns::RadiusIndex index(lng, 4);
+        for (const float cut : {0.5f, 5.0f, 30.0f})
+            for (auto const &ref_point : lng) {
+                vector<unsigned int> neighbors_i, indexed;
+                nns::calc_neighbors(neighbors_i, lng, ref_point, 0, lng.size(), cut * cut);
+                index.radius(ref_point, cut * cut, [&indexed](const unsigned int point, const float) {
+                    indexed.push_back(point);
+                });
+                std::sort(indexed.begin(), indexed.end());
+                BOOST_CHECK(indexed == neighbors_i);
+            }
+
+        // An index of a subset only visits the points of the subset
+        const vector<unsigned int> subset({1, 3, 5});
+        const nns::RadiusIndex subset_index(lng, subset, 1);
+        BOOST_CHECK_EQUAL(subset_index.size(), 3);
+        vector<unsigned int> indexed;
+        subset_index.radius(lng[0], 1e30f, [&indexed](const unsigned int point, const float) {
+            indexed.push_back(point);
+        });
+        std::sort(indexed.begin(), indexed.end());
+        BOOST_CHECK(indexed == subset);
+    }
+
+    BOOST_AUTO_TEST_CASE(hierarchy) {
+
+        Hierarchy tree;
+        tree.add_roots({{1, 2, 3, 4, 5, 6}, {7, 8}}, clstep(0, 1.0, 2));
+        tree.split(0, {{6, 5}, {2, 1}}, clstep(1, 0.5, 2));
+
+        // Children at the front of the parent range, then the dropped members
+        BOOST_CHECK(tree.members == vector<unsigned int>({6, 5, 2, 1, 3, 4, 7, 8}));
+        BOOST_CHECK_EQUAL(tree.nodes[0].first_child, 2);
+        BOOST_CHECK_EQUAL(tree.nodes[0].num_children, 2);
+        BOOST_CHECK_EQUAL(tree.nodes[3].parent, 0);
+        BOOST_CHECK(tree.cluster(3) == vector<unsigned int>({2, 1}));
+        BOOST_CHECK(tree.leaves() == vector<size_t>({2, 3, 1}));
+
+        vector<clstep> steps;
+        auto clusters = tree.leaf_clusters(steps);
+        BOOST_CHECK(clusters == vector<vector<unsigned int> >({{6, 5}, {2, 1}, {7, 8}}));
+        BOOST_CHECK_EQUAL(steps[0].step, 1);
+        BOOST_CHECK_EQUAL(steps[2].step, 0);
+    }
+
 BOOST_AUTO_TEST_SUITE_END()
 
 BOOST_FIXTURE_TEST_SUITE(CNNTestSuite, dataFixture)
@@ -188,6 +336,35 @@ BOOST_FIXTURE_TEST_SUITE(vsCNNTestSuite, dataFixture)
         BOOST_TEST(Geometry::regularized_intersection_volume(2.0f * std::sqrt(3.0f), std::sqrt(3.0f), 3) == 0.0f);
     }
 
+    BOOST_AUTO_TEST_CASE(intersection_volume_table) {
+        const double cut = std::sqrt(3.0);
+        for (unsigned int n : {1u, 3u, 12u}) {
+            Geometry::IntersectionVolumeTable table(cut, n, 256);
+            BOOST_TEST(table.error_bound() > 0.0);
+            BOOST_TEST(table.error_bound() < 0.1);
+            std::vector<float> distances;
+            for (unsigned int k = 0; k <= 1000; ++k) {
+                distances.push_back(static_cast<float>(2.0 * cut * k / 1000.0));
+            }
+            double previous = 1.0;
+            for (size_t k = 0; k < distances.size(); ++k) {
+                const double distance = distances[k];
+                const double exact = distance < 2.0 * cut
+                                     ? Geometry::regularized_intersection_volume(distance, cut, n) : 0.0;
+                const double interpolated = table(distance);
+                BOOST_TEST(std::abs(interpolated - exact) <= table.error_bound());
+                BOOST_TEST(interpolated <= previous);
+                previous = interpolated;
+                double lower, upper;
+                BOOST_TEST(table.bounds(distance, lower, upper));
+                BOOST_TEST(lower <= exact);
+                BOOST_TEST(exact <= upper);
+            }
+            double lower, upper;
+            BOOST_TEST(!table.bounds(2.5 * cut, lower, upper));
+        }
+    }
+
     BOOST_AUTO_TEST_CASE(vsCNNsimilarity) {
 
         const float cut = 2.0f * std::sqrt(3);
@@ -231,35 +408,41 @@ BOOST_FIXTURE_TEST_SUITE(CoreTestSuite, dataFixture)
         BOOST_CHECK(out2.empty());
     }
 
+    BOOST_AUTO_TEST_CASE(count_shared) {
+        const vector<unsigned int> list1 = {0, 1, 2, 3, 5, 7};
+        const vector<unsigned int> list2 = {2, 3, 4, 5, 6, 7};
+
+        // Unreachable counts stop early below `needed`
+        BOOST_CHECK_EQUAL(Clustering::Core::count_shared(list1, list2, 10), 0);
+        BOOST_CHECK(Clustering::Core::count_shared(list1, list2, 5) < 5);
+        BOOST_CHECK_EQUAL(Clustering::Core::count_shared(list1, list2, 4), 4);
+        BOOST_CHECK_EQUAL(Clustering::Core::count_shared(list1, list2, 2), 2);
+        BOOST_CHECK_EQUAL(Clustering::Core::count_shared(list1, list2, 0), 0);
+    }
+
 
     BOOST_AUTO_TEST_CASE(similarity) {
 
-        Clustering::Core::simptr similarity = Clustering::CommonNearestNeighbor::similarity;
+        Clustering::CommonNearestNeighbor::Similarity similarity(shrt, fixed_cut, fixed_sim);
 
         map<unsigned int, int> clustered;
         vector<vector<unsigned int> > clusters;
 
         unsigned int refpoint = 2;
         Clustering::Core::similarity_unclustered(similarity,
-                                                 shrt,
                                                  clustered,
                                                  clusters,
                                                  shrt_neighbor_lists,
                                                  shrt_neighbor_lists[refpoint],
-                                                 refpoint,
-                                                 fixed_cut,
-                                                 fixed_sim);
+                                                 refpoint);
 
         refpoint = 11;
         Clustering::Core::similarity_unclustered(similarity,
-                                                 shrt,
                                                  clustered,
                                                  clusters,
                                                  shrt_neighbor_lists,
                                                  shrt_neighbor_lists[refpoint],
-                                                 refpoint,
-                                                 fixed_cut,
-                                                 fixed_sim);
+                                                 refpoint);
 
         // Sort because of parallel loop in similarity_unclustered
         for (auto &cluster : clusters) {
@@ -279,25 +462,19 @@ BOOST_FIXTURE_TEST_SUITE(CoreTestSuite, dataFixture)
 
         refpoint = 3;
         Clustering::Core::similarity_clustered(similarity,
-                                               shrt,
                                                clustered,
                                                clusters,
                                                shrt_neighbor_lists,
                                                shrt_neighbor_lists[refpoint],
-                                               refpoint,
-                                               fixed_cut,
-                                               fixed_sim);
+                                               refpoint);
 
         refpoint = 10;
         Clustering::Core::similarity_clustered(similarity,
-                                               shrt,
                                                clustered,
                                                clusters,
                                                shrt_neighbor_lists,
                                                shrt_neighbor_lists[refpoint],
-                                               refpoint,
-                                               fixed_cut,
-                                               fixed_sim);
+                                               refpoint);
 
         // Sort because of parallel loop in similarity_unclustered
         for (auto &cluster : clusters) {
@@ -318,6 +495,111 @@ BOOST_FIXTURE_TEST_SUITE(CoreTestSuite, dataFixture)
         BOOST_CHECK(clusters[1][3] == 9);
     }
 
+    BOOST_AUTO_TEST_CASE(shared_neighbor_counts) {
+
+        const unsigned int refpoint = 3;
+        const vector<unsigned int> &points = lng_neighbor_lists[refpoint];
+
+        vector<unsigned int> counts;
+        BOOST_CHECK(Clustering::Core::shared_neighbor_counts(counts, lng_neighbor_lists, refpoint, points));
+        BOOST_CHECK_EQUAL(counts.size(), points.size());
+        for (size_t i = 0; i < points.size(); i++) {
+            vector<unsigned int> shared_neighbors;
+            Clustering::Core::intersection(shared_neighbors,
+                                           lng_neighbor_lists[refpoint],
+                                           lng_neighbor_lists[points[i]]);
+            BOOST_CHECK_EQUAL(counts[i], shared_neighbors.size());
+        }
+
+        // Not applicable if a neighbor of the reference point has no list
+        Neighbors incomplete(lng_neighbor_lists);
+        incomplete.erase(points[0]);
+        BOOST_CHECK(!Clustering::Core::shared_neighbor_counts(counts, incomplete, refpoint, points));
+    }
+
+    BOOST_AUTO_TEST_CASE(edge_states) {
+
+        Clustering::Core::EdgeStates states(40);
+        states.set(3, Clustering::Core::EdgeStates::similar);
+        states.set(17, Clustering::Core::EdgeStates::dissimilar);
+        states.set(39, Clustering::Core::EdgeStates::similar);
+
+        BOOST_CHECK_EQUAL(states.get(0), Clustering::Core::EdgeStates::unknown);
+        BOOST_CHECK_EQUAL(states.get(3), Clustering::Core::EdgeStates::similar);
+        BOOST_CHECK_EQUAL(states.get(16), Clustering::Core::EdgeStates::unknown);
+        BOOST_CHECK_EQUAL(states.get(17), Clustering::Core::EdgeStates::dissimilar);
+        BOOST_CHECK_EQUAL(states.get(39), Clustering::Core::EdgeStates::similar);
+    }
+
+    BOOST_AUTO_TEST_CASE(cached_similarity) {
+
+        Graph graph;
+        nns::graph(graph, shrt_neighbor_lists);
+        Clustering::CommonNearestNeighbor::Similarity policy(shrt, fixed_cut, fixed_sim);
+        Clustering::Core::CachedSimilarity<Clustering::CommonNearestNeighbor::Similarity> similarity(policy, graph);
+
+        // Same decisions as the bare policy in both directions of an edge
+        BOOST_CHECK(!similarity(shrt_neighbor_lists, 0, 1));
+        BOOST_CHECK(!similarity(shrt_neighbor_lists, 1, 0));
+        BOOST_CHECK(similarity(shrt_neighbor_lists, 2, 1));
+        BOOST_CHECK(similarity(shrt_neighbor_lists, 1, 2));
+    }
+
+    BOOST_AUTO_TEST_CASE(edge_thresholds) {
+
+        Graph graph;
+        nns::graph(graph, lng_neighbor_lists);
+        nns::distances(graph, lng);
+        for (unsigned int sim : {0u, 2u, 5u}) {
+            Clustering::CommonDensity::Similarity policy(lng, fixed_cut, sim);
+            Clustering::Core::CachedSimilarity<Clustering::CommonDensity::Similarity> similarity(policy, graph);
+
+            // The threshold is the smallest similar number of shared neighbors
+            for (unsigned int point = 0; point < graph.num_points(); point++) {
+                for (size_t edge = graph.offsets[point]; edge < graph.offsets[point + 1]; edge++) {
+                    const unsigned int neighbor = graph.edges[edge];
+                    const unsigned int threshold = policy.threshold(graph.distances[edge]);
+                    BOOST_CHECK(policy(threshold, point, neighbor));
+                    if (threshold > 0)
+                        BOOST_CHECK(!policy(threshold - 1, point, neighbor));
+                    BOOST_CHECK_EQUAL(similarity(lng_neighbor_lists, point, neighbor),
+                                      policy(lng_neighbor_lists, point, neighbor));
+                }
+            }
+        }
+    }
+
+    BOOST_AUTO_TEST_CASE(parallel_tasks) {
+
+        // Nested tasks visit every index exactly once
+        vector<vector<int> > visits(8, vector<int>(100, 0));
+        Clustering::Utility::parallel_tasks(visits.size(), 1, [&](const size_t i) {
+            Clustering::Utility::parallel_tasks(visits[i].size(), 8, [&](const size_t j) {
+#pragma omp atomic update
+                visits[i][j] += 1;
+            });
+        });
+
+        for (auto const &row : visits)
+            for (auto const &count : row)
+                BOOST_CHECK_EQUAL(count, 1);
+
+        // A budget of one thread runs the nested loop on the calling thread
+        vector<int> threads(8, -1);
+        Clustering::Utility::parallel_tasks(threads.size(), 1, [&](const size_t i) {
+            Clustering::Utility::ThreadBudget budget(1);
+            const int thread = omp_get_thread_num();
+            bool inline_loop = true;
+            Clustering::Utility::parallel_tasks(100, 8, [&](const size_t j) {
+                if (omp_get_thread_num() != thread) inline_loop = false;
+            });
+            threads[i] = inline_loop ? 1 : 0;
+        });
+        for (auto const &inline_loop : threads)
+            BOOST_CHECK_EQUAL(inline_loop, 1);
+        BOOST_CHECK_EQUAL(omp_get_max_threads() > 0, true);
+    }
+
     BOOST_AUTO_TEST_CASE(CNNalgorithm) {
 
         const float cut = 5.0;
@@ -325,14 +607,13 @@ BOOST_FIXTURE_TEST_SUITE(CoreTestSuite, dataFixture)
 
         Neighbors dummy_neighbors;
         vector<vector<unsigned int> > clusters;
-        clusters = Clustering::Core::algorithm(Clustering::CommonNearestNeighbor::similarity,
-                                               mdm,
-                                               mdm_neighbor_lists,
-                                               dummy_neighbors,
-                                               cut,
-                                               sim,
-                                               0,
-                                               true);
+        clusters = Clustering::Core::algorithm<Clustering::CommonNearestNeighbor::Similarity>(mdm,
+                                                                                              mdm_neighbor_lists,
+                                                                                              dummy_neighbors,
+                                                                                              cut,
+                                                                                              sim,
+                                                                                              0,
+                                                                                              true);
 
         for (auto &cluster : clusters) {
             std::sort(cluster.begin(), cluster.end(),
@@ -363,14 +644,13 @@ BOOST_FIXTURE_TEST_SUITE(CoreTestSuite, dataFixture)
 
         Neighbors dummy_neighbors;
         vector<vector<unsigned int> > clusters;
-        clusters = Clustering::Core::algorithm(Clustering::CommonDensity::similarity,
-                                               mdm,
-                                               mdm_neighbor_lists,
-                                               dummy_neighbors,
-                                               cut,
-                                               sim,
-                                               0,
-                                               true);
+        clusters = Clustering::Core::algorithm<Clustering::CommonDensity::Similarity>(mdm,
+                                                                                      mdm_neighbor_lists,
+                                                                                      dummy_neighbors,
+                                                                                      cut,
+                                                                                      sim,
+                                                                                      0,
+                                                                                      true);
 
         for (auto &cluster : clusters) {
             std::sort(cluster.begin(), cluster.end(),
@@ -397,6 +677,185 @@ BOOST_FIXTURE_TEST_SUITE(CoreTestSuite, dataFixture)
         BOOST_CHECK_EQUAL(clusters[1][6], 9);
     }
 
+    BOOST_AUTO_TEST_CASE(deterministic_algorithm) {
+
+        const unsigned int sim = 3;
+        const int max_threads = omp_get_max_threads();
+
+        Neighbors dummy_neighbors;
+        vector<vector<vector<unsigned int> > > runs;
+        for (int threads : {1, 2, 4}) {
+            omp_set_num_threads(threads);
+            runs.push_back(Clustering::Core::algorithm<Clustering::CommonDensity::Similarity>(lng,
+                                                                                              lng_neighbor_lists,
+                                                                                              dummy_neighbors,
+                                                                                              fixed_cut,
+                                                                                              sim,
+                                                                                              2,
+                                                                                              true,
+                                                                                              true));
+        }
+        omp_set_num_threads(max_threads);
+
+        // Identical output for any number of threads with ascending members
+        BOOST_CHECK(!runs[0].empty());
+        BOOST_CHECK(runs[0] == runs[1]);
+        BOOST_CHECK(runs[0] == runs[2]);
+        for (auto const &cluster : runs[0])
+            BOOST_CHECK(std::is_sorted(cluster.begin(), cluster.end()));
+
+        // Same clusters as the default mode
+        vector<vector<unsigned int> > clusters;
+        clusters = Clustering::Core::algorithm<Clustering::CommonDensity::Similarity>(lng,
+                                                                                      lng_neighbor_lists,
+                                                                                      dummy_neighbors,
+                                                                                      fixed_cut,
+                                                                                      sim,
+                                                                                      2,
+                                                                                      true);
+        for (auto &cluster : clusters)
+            std::sort(cluster.begin(), cluster.end());
+        std::sort(clusters.begin(), clusters.end());
+        vector<vector<unsigned int> > deterministic_clusters(runs[0]);
+        std::sort(deterministic_clusters.begin(), deterministic_clusters.end());
+        BOOST_CHECK(clusters == deterministic_clusters);
+    }
+
+    BOOST_AUTO_TEST_CASE(speculative_clusters) {
+
+        const unsigned int sim = 3;
+        const int max_threads = omp_get_max_threads();
+
+        Neighbors dummy_neighbors;
+        vector<unsigned int> seeds;
+        for (auto const &list : lng_neighbor_lists)
+            seeds.push_back(list.first);
+        Graph graph;
+        nns::graph(graph, lng_neighbor_lists);
+        Clustering::CommonDensity::Similarity similarity(lng, fixed_cut, sim);
+
+        // Regions grown in parallel give the sequential clusters
+        omp_set_num_threads(4);
+        vector<vector<unsigned int> > clusters;
+        clusters = Clustering::Core::speculative_clusters(similarity,
+                                                          lng_neighbor_lists,
+                                                          graph,
+                                                          seeds);
+        omp_set_num_threads(1);
+        vector<vector<unsigned int> > sequential_clusters;
+        sequential_clusters = Clustering::Core::algorithm<Clustering::CommonDensity::Similarity>(lng,
+                                                                                                 lng_neighbor_lists,
+                                                                                                 dummy_neighbors,
+                                                                                                 fixed_cut,
+                                                                                                 sim,
+                                                                                                 0,
+                                                                                                 true);
+        omp_set_num_threads(4);
+        vector<vector<unsigned int> > parallel_clusters;
+        parallel_clusters = Clustering::Core::algorithm<Clustering::CommonDensity::Similarity>(lng,
+                                                                                               lng_neighbor_lists,
+                                                                                               dummy_neighbors,
+                                                                                               fixed_cut,
+                                                                                               sim,
+                                                                                               0,
+                                                                                               true);
+        omp_set_num_threads(max_threads);
+
+        // The default mode gives the same order for any number of threads
+        BOOST_CHECK(parallel_clusters == sequential_clusters);
+
+        BOOST_CHECK(!clusters.empty());
+        for (auto const &cluster : clusters)
+            BOOST_CHECK(std::is_sorted(cluster.begin(), cluster.end()));
+        for (auto &cluster : sequential_clusters)
+            std::sort(cluster.begin(), cluster.end());
+        std::sort(clusters.begin(), clusters.end());
+        std::sort(sequential_clusters.begin(), sequential_clusters.end());
+        BOOST_CHECK(clusters == sequential_clusters);
+    }
+
+    BOOST_AUTO_TEST_CASE(nonmutual_algorithm) {
+
+        const unsigned int sim = 2;
+        const int max_threads = omp_get_max_threads();
+
+        Neighbors neighbors_ij;
+        Neighbors second_neighbors_ij;
+        nns::neighbors(neighbors_ij, second_neighbors_ij, lng, fixed_cut, 0, false);
+
+        // Sequential, speculative, and deterministic growth over both shells agree
+        vector<vector<vector<unsigned int> > > runs;
+        for (int threads : {1, 4}) {
+            omp_set_num_threads(threads);
+            for (bool deterministic : {false, true})
+                runs.push_back(Clustering::Core::algorithm<Clustering::CommonNearestNeighbor::Similarity>(lng,
+                                                                                                          neighbors_ij,
+                                                                                                          second_neighbors_ij,
+                                                                                                          fixed_cut,
+                                                                                                          sim,
+                                                                                                          0,
+                                                                                                          false,
+                                                                                                          deterministic));
+        }
+        omp_set_num_threads(max_threads);
+
+        for (auto &clusters : runs) {
+            for (auto &cluster : clusters)
+                std::sort(cluster.begin(), cluster.end());
+            std::sort(clusters.begin(), clusters.end());
+        }
+        BOOST_CHECK(!runs[0].empty());
+        for (size_t i = 1; i < runs.size(); i++)
+            BOOST_CHECK(runs[0] == runs[i]);
+    }
+
+    BOOST_AUTO_TEST_CASE(sweep) {
+
+        const vector<unsigned int> sims = {4, 2, 3, 6};
+
+        // Every threshold equals a separate mutual neighbor clustering
+        auto sorted = [](vector<vector<unsigned int> > clusters) {
+            for (auto &cluster : clusters)
+                std::sort(cluster.begin(), cluster.end());
+            std::sort(clusters.begin(), clusters.end());
+            return clusters;
+        };
+        Neighbors dummy_neighbors;
+        vector<vector<vector<unsigned int> > > cnn_sweep;
+        vector<vector<vector<unsigned int> > > vscnn_sweep;
+        cnn_sweep = Clustering::Core::sweep<Clustering::CommonNearestNeighbor::Similarity>(lng,
+                                                                                           lng_neighbor_lists,
+                                                                                           fixed_cut,
+                                                                                           sims,
+                                                                                           2);
+        vscnn_sweep = Clustering::Core::sweep<Clustering::CommonDensity::Similarity>(lng,
+                                                                                     lng_neighbor_lists,
+                                                                                     fixed_cut,
+                                                                                     sims,
+                                                                                     2);
+        BOOST_CHECK_EQUAL(cnn_sweep.size(), sims.size());
+        BOOST_CHECK_EQUAL(vscnn_sweep.size(), sims.size());
+        for (size_t i = 0; i < sims.size(); i++) {
+            vector<vector<unsigned int> > clusters;
+            clusters = Clustering::Core::algorithm<Clustering::CommonNearestNeighbor::Similarity>(lng,
+                                                                                                  lng_neighbor_lists,
+                                                                                                  dummy_neighbors,
+                                                                                                  fixed_cut,
+                                                                                                  sims[i],
+                                                                                                  2,
+                                                                                                  true);
+            BOOST_CHECK(sorted(cnn_sweep[i]) == sorted(clusters));
+            clusters = Clustering::Core::algorithm<Clustering::CommonDensity::Similarity>(lng,
+                                                                                          lng_neighbor_lists,
+                                                                                          dummy_neighbors,
+                                                                                          fixed_cut,
+                                                                                          sims[i],
+                                                                                          2,
+                                                                                          true);
+            BOOST_CHECK(sorted(vscnn_sweep[i]) == sorted(clusters));
+        }
+    }
+
 BOOST_AUTO_TEST_SUITE_END()
 
 BOOST_FIXTURE_TEST_SUITE(ClusteringTestSuite, dataFixture)
@@ -407,12 +866,11 @@ BOOST_FIXTURE_TEST_SUITE(ClusteringTestSuite, dataFixture)
         const unsigned int sim = 2;
 
         vector<vector<unsigned int> > clusters;
-        clusters = Clustering::clustering(Clustering::CommonNearestNeighbor::similarity,
-                                          mdm,
-                                          cut,
-                                          sim,
-                                          0,
-                                          true);
+        clusters = Clustering::clustering<Clustering::CommonNearestNeighbor::Similarity>(mdm,
+                                                                                         cut,
+                                                                                         sim,
+                                                                                         0,
+                                                                                         true);
 
         for (auto &cluster : clusters) {
             std::sort(cluster.begin(), cluster.end(),
@@ -441,12 +899,11 @@ BOOST_FIXTURE_TEST_SUITE(ClusteringTestSuite, dataFixture)
         const unsigned int sim = 2;
 
         vector<vector<unsigned int> > clusters;
-        clusters = Clustering::clustering(Clustering::CommonDensity::similarity,
-                                          mdm,
-                                          cut,
-                                          sim,
-                                          0,
-                                          true);
+        clusters = Clustering::clustering<Clustering::CommonDensity::Similarity>(mdm,
+                                                                                 cut,
+                                                                                 sim,
+                                                                                 0,
+                                                                                 true);
 
         for (auto &cluster : clusters) {
             std::sort(cluster.begin(), cluster.end(),
@@ -473,7 +930,403 @@ BOOST_FIXTURE_TEST_SUITE(ClusteringTestSuite, dataFixture)
         BOOST_CHECK_EQUAL(clusters[1][6], 9);
     }
 
-BOOST_AUTO_TEST_SUITE_END()
+    // Test-local similarity policy, i.e., the neighbor criterion of CNN
+    // without any shortcut, which is not instantiated by the library
+    class SharedNeighbors {
+    public:
+        SharedNeighbors(const vector<vector<float> > &,
+                        const float,
+                        const unsigned int sim) : sim_(sim) {}
+
+        static constexpr bool distance_dependent = false;
+
+        bool operator()(const Neighbors &neighbors_ij,
+                        const unsigned int refpoint,
+                        const unsigned int point) const {
+            vector<unsigned int> shared;
+            Clustering::Core::intersection(shared, neighbors_ij.at(refpoint), neighbors_ij.at(point));
+            return (*this)(shared.size(), refpoint, point);
+        }
 
+        bool operator()(const size_t shared,
+                        const unsigned int,
+                        const unsigned int) const {
+            return (shared >= sim_);
+        }
 
+        unsigned int threshold(const float) const {
+            return sim_;
+        }
+
+        double score(const size_t shared,
+                     const unsigned int,
+                     const unsigned int) const {
+            return static_cast<double>(shared);
+        }
+
+        bool mapping(const size_t shared) const {
+            return (shared >= sim_);
+        }
+
+    private:
+        const unsigned int sim_;
+    };
+
+    BOOST_AUTO_TEST_CASE(clustering_custom_policy) {
+
+        const float cut = 5.0;
+        const unsigned int sim = 2;
+
+        vector<vector<unsigned int> > clusters;
+        clusters = Clustering::clustering<SharedNeighbors>(mdm, cut, sim, 0, true, true);
+
+        BOOST_CHECK_EQUAL(clusters.size(), 2);
+        BOOST_CHECK(clusters == Clustering::clustering<Clustering::CommonNearestNeighbor::Similarity>(mdm,
+                                                                                                      cut,
+                                                                                                      sim,
+                                                                                                      0,
+                                                                                                      true,
+                                                                                                      true));
+    }
+
+    BOOST_AUTO_TEST_CASE(incremental_clustering) {
+
+        // The even points of lng are too far apart to cluster on their own,
+        // the appended odd points fill the gaps and merge them
+        vector<vector<float> > data;
+        for (unsigned int start : {0, 1})
+            for (unsigned int point = start; point < lng.size(); point += 2)
+                data.push_back(lng[point]);
+        const unsigned int num_old((lng.size() + 1) / 2);
+        vector<vector<float> > old_data(data.begin(), data.begin() + num_old);
+        const float cut = 4.0;
+        const unsigned int sim = 2;
+
+        vector<unsigned int> components;
+        auto clusters = Clustering::incremental_clustering<Clustering::CommonNearestNeighbor::Similarity>(
+                components, old_data, cut, sim, 2);
+        BOOST_CHECK(clusters.empty());
+        BOOST_CHECK_EQUAL(components.size(), num_old);
+        clusters = Clustering::incremental_clustering<Clustering::CommonNearestNeighbor::Similarity>(
+                components, data, cut, sim, 2);
+        BOOST_CHECK(!clusters.empty());
+        BOOST_CHECK(clusters == Clustering::clustering<Clustering::CommonNearestNeighbor::Similarity>(
+                data, cut, sim, 2, true, true));
+
+        // Appending equals clustering all points at once
+        vector<unsigned int> all_components;
+        auto all_clusters = Clustering::incremental_clustering<Clustering::CommonNearestNeighbor::Similarity>(
+                all_components, data, cut, sim, 2);
+        BOOST_CHECK(all_clusters == clusters);
+        BOOST_CHECK(all_components == components);
+
+        // The components of a run are restored from their file
+        const std::string componentfile("incremental_clustering_test-components.bin");
+        write_components(componentfile, data_hash(data, num_old), components);
+        vector<unsigned int> file_components;
+        uint64_t key(0);
+        BOOST_REQUIRE(read_components(componentfile, key, file_components));
+        BOOST_CHECK_EQUAL(key, data_hash(old_data));
+        BOOST_CHECK(file_components == components);
+        std::remove(componentfile.c_str());
+        BOOST_CHECK(!read_components(componentfile, key, file_components));
+
+        components.clear();
+        Clustering::incremental_clustering<Clustering::CommonDensity::Similarity>(
+                components, old_data, cut, sim, 2);
+        clusters = Clustering::incremental_clustering<Clustering::CommonDensity::Similarity>(
+                components, data, cut, sim, 2);
+        BOOST_CHECK(clusters == Clustering::clustering<Clustering::CommonDensity::Similarity>(
+                data, cut, sim, 2, true, true));
+    }
+
+    BOOST_AUTO_TEST_CASE(stream_clustering) {
+
+        // A trajectory visits a state, leaves it for another one and returns
+        auto state = [](const float origin, const unsigned int frame) {
+            return vector<float>({origin + 0.1f * static_cast<float>(frame % 20), 0.0f, 0.0f});
+        };
+        vector<vector<float> > stream;
+        for (const float origin : {0.0f, 100.0f, 0.0f})
+            for (unsigned int frame = 0; frame < 40; frame++)
+                stream.push_back(state(origin, frame));
+
+        Clustering::StreamClustering<Clustering::CommonNearestNeighbor::Similarity> clustering(0.45, 2, 2, 30, 8);
+        vector<int> ids;
+        for (size_t begin = 0; begin < stream.size(); begin += 10) {
+            const vector<vector<float> > frames(stream.begin() + begin, stream.begin() + begin + 10);
+            const vector<int> frame_ids(clustering.update(frames));
+            ids.insert(ids.end(), frame_ids.begin(), frame_ids.end());
+            BOOST_CHECK_LE(clustering.size(), 30);
+        }
 
+        // The returning state gets its former ID from its representatives
+        BOOST_CHECK_EQUAL(clustering.num_ids(), 2);
+        for (size_t frame = 0; frame < ids.size(); frame++)
+            BOOST_CHECK_EQUAL(ids[frame], (frame / 40 == 1) ? 1 : 0);
+        BOOST_CHECK(clustering.labels() == vector<int>(30, 0));
+
+        // Frames that enter and leave merge and split the clusters of the
+        // window, which stay those of the deterministic mode
+        vector<vector<float> > walk;
+        for (unsigned int frame = 0; frame < 200; frame++)
+            walk.push_back({0.3f * static_cast<float>((frame * 7) % 13), 0.3f * static_cast<float>((frame * 5) % 11)});
+        Clustering::StreamClustering<Clustering::CommonNearestNeighbor::Similarity> walk_clustering(0.5, 2, 2, 40);
+        for (size_t begin = 0; begin < walk.size(); begin += 7) {
+            const size_t end(std::min(walk.size(), begin + 7));
+            walk_clustering.update(vector<vector<float> >(walk.begin() + begin, walk.begin() + end));
+            vector<vector<float> > window(walk.begin() + (end > 40 ? end - 40 : 0), walk.begin() + end);
+            map<int, vector<unsigned int> > members;
+            const vector<int> labels(walk_clustering.labels());
+            for (unsigned int point = 0; point < labels.size(); point++)
+                if (labels[point] >= 0) { members[labels[point]].push_back(point); }
+            vector<vector<unsigned int> > clusters;
+            for (auto const &cluster : members)
+                clusters.push_back(cluster.second);
+            Clustering::Utility::sortNclean(clusters, 2, true);
+            BOOST_CHECK(clusters == Clustering::clustering<Clustering::CommonNearestNeighbor::Similarity>(
+                    window, 0.5, 2, 2, true, true));
+        }
+
+        // Only `max_ids` IDs keep representatives, the least recently seen
+        // is forgotten first, such that a state gets a new ID once evicted
+        vector<vector<float> > tour;
+        for (const float origin : {0.0f, 100.0f, 200.0f, 300.0f, 400.0f, 0.0f, 400.0f})
+            for (unsigned int frame = 0; frame < 40; frame++)
+                tour.push_back(state(origin, frame));
+        Clustering::StreamClustering<Clustering::CommonNearestNeighbor::Similarity> tour_clustering(
+                0.45, 2, 2, 30, 8, 2);
+        ids.clear();
+        for (size_t begin = 0; begin < tour.size(); begin += 10) {
+            const vector<int> frame_ids(tour_clustering.update(
+                    vector<vector<float> >(tour.begin() + begin, tour.begin() + begin + 10)));
+            ids.insert(ids.end(), frame_ids.begin(), frame_ids.end());
+            BOOST_CHECK_LE(tour_clustering.num_kept_ids(), 2);
+        }
+        const vector<int> tour_ids({0, 1, 2, 3, 4, 5, 4});
+        for (size_t frame = 0; frame < ids.size(); frame++)
+            BOOST_CHECK_EQUAL(ids[frame], tour_ids[frame / 40]);
+        BOOST_CHECK_EQUAL(tour_clustering.num_ids(), 6);
+    }
+
+    BOOST_AUTO_TEST_CASE(hierarchy_file) {
+
+        const float cut = 5.0;
+        const unsigned int sim = 2;
+        vector<vector<unsigned int> > clusters;
+        clusters = Clustering::clustering<Clustering::CommonNearestNeighbor::Similarity>(mdm, cut, sim, 2, true, true);
+
+        vector<vector<unsigned int> > leaf_clusters(clusters);
+        vector<clstep> leaves;
+        leaves = Clustering::hierarchical_clustering<Clustering::CommonNearestNeighbor::Similarity>(
+                leaf_clusters, mdm, clstep(0, cut, sim), 1.0, mdm[0].size(), 2, 4, true, true);
+
+        const std::string treefile("hierarchy_file_test-tree.bin");
+        Hierarchy tree;
+        tree.add_roots(clusters, clstep(0, cut, sim));
+        Clustering::hierarchical_clustering<Clustering::CommonNearestNeighbor::Similarity>(
+                tree, mdm, 1.0, mdm[0].size(), 2, 4, true, true, treefile);
+
+        // Replaying the written levels gives the same tree and leaves
+        Hierarchy read_tree = read_hierarchy(treefile);
+        std::remove(treefile.c_str());
+        BOOST_CHECK(read_tree.members == tree.members);
+        BOOST_CHECK_EQUAL(read_tree.nodes.size(), tree.nodes.size());
+        vector<clstep> read_leaves;
+        BOOST_CHECK(read_tree.leaf_clusters(read_leaves) == leaf_clusters);
+        BOOST_CHECK_EQUAL(read_leaves.size(), leaves.size());
+    }
+
+    BOOST_AUTO_TEST_CASE(hierarchy_checkpoint) {
+
+        const clstep init_step(0, 30.0, 2);
+        const float bfactor(std::exp(-1.0f / lng[0].size()));
+        vector<vector<unsigned int> > roots;
+        roots = Clustering::clustering<Clustering::CommonNearestNeighbor::Similarity>(lng, 30.0, 2, 2, true, true);
+
+        const std::string treefile("hierarchy_checkpoint_test-tree.bin");
+        const std::string checkpointfile(treefile + ".ckpt");
+        Hierarchy tree;
+        tree.add_roots(roots, init_step);
+        Clustering::hierarchical_clustering<Clustering::CommonNearestNeighbor::Similarity>(
+                tree, lng, 1.0, lng[0].size(), 2, 4, true, true, treefile);
+        BOOST_REQUIRE_GT(tree.nodes.size(), roots.size());
+
+        // The key of the run follows the magic of its checkpoint
+        uint64_t key;
+        std::ifstream keystream(checkpointfile, std::ios::binary);
+        keystream.seekg(8);
+        BOOST_REQUIRE(keystream.read(reinterpret_cast<char *>(&key), sizeof(key)));
+        keystream.close();
+
+        // Interrupted after the first level that split
+        const clstep first_split(tree.nodes[roots.size()].step);
+        Hierarchy partial;
+        partial.add_roots(roots, init_step);
+        for (size_t root = 0; root < roots.size(); root++) {
+            if (tree.nodes[root].leaf() || tree.nodes[tree.nodes[root].first_child].step.step != first_split.step)
+                continue;
+            vector<vector<unsigned int> > children;
+            for (size_t child = 0; child < tree.nodes[root].num_children; child++)
+                children.push_back(tree.cluster(tree.nodes[root].first_child + child));
+            partial.split(root, children, first_split);
+        }
+        vector<char> active(partial.nodes.size(), 0);
+        for (auto const &leaf : partial.leaves())
+            active[leaf] = 1;
+        write_checkpoint(checkpointfile, key, partial, active,
+                         clstep(first_split.step + 1, first_split.cut * bfactor, first_split.sim));
+
+        // Fast and deterministic runs continue from each other's checkpoints
+        Hierarchy resumed;
+        resumed.add_roots(roots, init_step);
+        Clustering::fast_hierarchical_clustering<Clustering::CommonNearestNeighbor::Similarity>(
+                resumed, lng, 1.0, lng[0].size(), 2, 4, true, treefile, true);
+        BOOST_CHECK_EQUAL(resumed.nodes.size(), tree.nodes.size());
+        BOOST_CHECK(resumed.members == tree.members);
+        for (size_t node = 0; node < tree.nodes.size(); node++) {
+            BOOST_CHECK_EQUAL(resumed.nodes[node].parent, tree.nodes[node].parent);
+            BOOST_CHECK_EQUAL(resumed.nodes[node].step.step, tree.nodes[node].step.step);
+        }
+        BOOST_CHECK(read_hierarchy(treefile).members == tree.members);
+
+        // A checkpoint of other parameters is refused
+        Hierarchy other;
+        other.add_roots(roots, init_step);
+        BOOST_CHECK_THROW(Clustering::hierarchical_clustering<Clustering::CommonNearestNeighbor::Similarity>(
+                other, lng, 1.0, lng[0].size(), 3, 4, true, true, treefile, true), std::runtime_error);
+        std::remove(treefile.c_str());
+        std::remove(checkpointfile.c_str());
+    }
+
+    BOOST_AUTO_TEST_CASE(fast_hierarchical_clustering) {
+
+        // Two close chains of lng are split from one root on a later level
+        const clstep init_step(0, 30.0, 2);
+        vector<vector<unsigned int> > roots;
+        roots = Clustering::clustering<Clustering::CommonNearestNeighbor::Similarity>(lng, 30.0, 2, 2, true, true);
+
+        Hierarchy tree, fast_tree;
+        tree.add_roots(roots, init_step);
+        fast_tree.add_roots(roots, init_step);
+        Clustering::hierarchical_clustering<Clustering::CommonNearestNeighbor::Similarity>(
+                tree, lng, 1.0, lng[0].size(), 2, 4, true, true, "");
+        Clustering::fast_hierarchical_clustering<Clustering::CommonNearestNeighbor::Similarity>(
+                fast_tree, lng, 1.0, lng[0].size(), 2, 4, true, "");
+        BOOST_CHECK_GT(tree.nodes.size(), roots.size());
+        BOOST_CHECK_EQUAL(fast_tree.nodes.size(), tree.nodes.size());
+        BOOST_CHECK(fast_tree.members == tree.members);
+
+        tree = Hierarchy();
+        fast_tree = Hierarchy();
+        tree.add_roots(roots, init_step);
+        fast_tree.add_roots(roots, init_step);
+        Clustering::hierarchical_clustering<Clustering::CommonDensity::Similarity>(
+                tree, lng, 1.0, lng[0].size(), 2, 4, true, true, "");
+        Clustering::fast_hierarchical_clustering<Clustering::CommonDensity::Similarity>(
+                fast_tree, lng, 1.0, lng[0].size(), 2, 4, true, "");
+        BOOST_CHECK_EQUAL(fast_tree.nodes.size(), tree.nodes.size());
+        BOOST_CHECK(fast_tree.members == tree.members);
+        for (size_t node = 0; node < tree.nodes.size(); node++) {
+            BOOST_CHECK_EQUAL(fast_tree.nodes[node].parent, tree.nodes[node].parent);
+            BOOST_CHECK_EQUAL(fast_tree.nodes[node].step.step, tree.nodes[node].step.step);
+        }
+    }
+
+    BOOST_AUTO_TEST_CASE(cluster_mapping) {
+
+        // Two groups on a line, of which every second frame is clustered
+        vector<vector<float> > full_data;
+        for (unsigned int frame = 0; frame < 20; frame++)
+            full_data.push_back({(frame < 10 ? 0.0f : 10.0f) + 0.1f * static_cast<float>(frame % 10)});
+        vector<vector<float> > reduced_data;
+        map<unsigned int, unsigned int> frames;
+        for (unsigned int frame = 0; frame < 20; frame += 2) {
+            frames[reduced_data.size()] = frame;
+            reduced_data.push_back(full_data[frame]);
+        }
+
+        const float cut = 0.45;
+        const unsigned int sim = 2;
+        vector<vector<unsigned int> > reduced_clusters;
+        reduced_clusters = Clustering::clustering<Clustering::CommonNearestNeighbor::Similarity>(
+                reduced_data, cut, sim, 2, true, true);
+        BOOST_REQUIRE_EQUAL(reduced_clusters.size(), 2);
+        vector<clstep> leaves(reduced_clusters.size(), clstep(0, cut, sim));
+
+        for (const bool cnn : {true, false}) {
+            vector<vector<unsigned int> > clusters(reduced_clusters);
+            if (cnn)
+                Clustering::cluster_mapping<Clustering::CommonNearestNeighbor::Similarity>(
+                        clusters, full_data, reduced_data, frames, leaves);
+            else
+                Clustering::cluster_mapping<Clustering::CommonDensity::Similarity>(
+                        clusters, full_data, reduced_data, frames, leaves);
+
+            // The frames between the clustered frames 2, 4, 6 and 12, 14, 16
+            // join their clusters, while the ends lack neighbors
+            for (auto &cluster : clusters)
+                std::sort(cluster.begin(), cluster.end());
+            std::sort(clusters.begin(), clusters.end());
+            vector<unsigned int> first(7), second(7);
+            std::iota(first.begin(), first.end(), 1);
+            std::iota(second.begin(), second.end(), 11);
+            BOOST_CHECK(clusters[0] == first);
+            BOOST_CHECK(clusters[1] == second);
+        }
+
+        // Descending from a root of both groups at a larger cut gives the same leaves
+        Hierarchy tree;
+        vector<unsigned int> all(reduced_data.size());
+        std::iota(all.begin(), all.end(), 0);
+        tree.add_roots({all}, clstep(0, 20.0, sim));
+        tree.split(0, reduced_clusters, clstep(1, cut, sim));
+        vector<clstep> tree_leaves;
+        vector<vector<unsigned int> > clusters;
+        clusters = Clustering::hierarchy_mapping<Clustering::CommonNearestNeighbor::Similarity>(
+                tree, full_data, reduced_data, frames, tree_leaves);
+        BOOST_REQUIRE_EQUAL(clusters.size(), 2);
+        BOOST_CHECK_EQUAL(tree_leaves[0].step, 1);
+        for (auto &cluster : clusters)
+            std::sort(cluster.begin(), cluster.end());
+        std::sort(clusters.begin(), clusters.end());
+        BOOST_CHECK(clusters[0] == vector<unsigned int>({1, 2, 3, 4, 5, 6, 7}));
+        BOOST_CHECK(clusters[1] == vector<unsigned int>({11, 12, 13, 14, 15, 16, 17}));
+    }
+
+    BOOST_AUTO_TEST_CASE(assigner) {
+
+        vector<vector<float> > reduced_data;
+        for (unsigned int point = 0; point < 10; point++)
+            reduced_data.push_back({(point < 5 ? 0.0f : 10.0f) + 0.2f * static_cast<float>(point % 5)});
+        const vector<vector<unsigned int> > clusters({{0, 1, 2, 3, 4}, {5, 6, 7, 8, 9}});
+        const vector<clstep> leaves(clusters.size(), clstep(0, 0.45, 2));
+        const Clustering::Assigner<Clustering::CommonNearestNeighbor::Similarity> assigner(
+                clusters, reduced_data, leaves);
+        BOOST_CHECK_EQUAL(assigner.num_clusters(), 2);
+
+        // Frames within the groups are assigned to them, the others to none
+        const vector<vector<float> > frames({{0.3f}, {10.5f}, {5.0f}, {-0.6f}});
+        BOOST_CHECK(assigner.assign(frames) == vector<int>({0, 1, -1, -1}));
+        BOOST_CHECK_EQUAL(assigner.assign(frames[1]), 1);
+    }
+
+    BOOST_AUTO_TEST_CASE(dtrajs) {
+
+        const vector<vector<unsigned int> > clusters({{4, 0, 7}, {2, 5}});
+        const vector<unsigned int> traj_shapes({3, 0, 5});
+        BOOST_CHECK(Clustering::Discretization::offsets(traj_shapes) == vector<size_t>({0, 3, 3, 8}));
+
+        const vector<int> labels(Clustering::Discretization::labels(clusters, 8));
+        BOOST_CHECK(labels == vector<int>({0, -1, 1, -1, 0, 1, -1, 0}));
+
+        // Both interfaces slice the concatenated frames into the trajectories
+        const vector<vector<int> > expected({{0, -1, 1}, {}, {-1, 0, 1, -1, 0}});
+        BOOST_CHECK(Clustering::Discretization::dtrajs(clusters, traj_shapes) == expected);
+        BOOST_CHECK(Clustering::Discretization::dtrajs(labels, traj_shapes) == expected);
+        BOOST_CHECK_THROW(Clustering::Discretization::labels(clusters, 7), std::out_of_range);
+        BOOST_CHECK_THROW(Clustering::Discretization::dtrajs(labels, vector<unsigned int>({3, 4})),
+                          std::invalid_argument);
+    }
+
+BOOST_AUTO_TEST_SUITE_END()